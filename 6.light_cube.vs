@@ -1,11 +1,20 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCING
+// 每个实例的模型矩阵，占用位置7到10
+layout (location = 7) in mat4 aInstanceModel;
+#endif
 
+#include "camera.glsl"
+
+#ifndef INSTANCING
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
 
 void main()
 {
+#ifdef INSTANCING
+    mat4 model = aInstanceModel;
+#endif
     gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+}
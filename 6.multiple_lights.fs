@@ -1,141 +1,68 @@
 #version 330 core
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    float shininess;
-};
-
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 4
-
-in vec3 FragPos;
-in vec3 Normal;
-in vec2 TexCoords;
-
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-
-// 功能原型
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+// 变体宏（由shader_features生成）:
+// NR_POINT_LIGHTS   计算的点光源数量，0到MAX_POINT_LIGHTS
+// HAS_DIR_LIGHT     计算平行光
+// HAS_SPOT_LIGHT    计算聚光灯
+// HAS_SPECULAR_MAP  使用镜面反射贴图（单通道遮罩，只使用r分量），否则使用material.specularStrength
+// PACKED_SPECULAR   镜面反射遮罩打包在漫反射贴图的alpha通道中，只需要一个采样器
+// HAS_NORMAL_MAP    使用切线空间法线贴图
+// CLUSTERED_LIGHTS  点光源来自分簇的光源列表（clusters.glsl），只计算片段所在簇中的光源
+// OBJECT_LIGHTS     只计算CPU为这次绘制挑选的点光源和聚光灯（light_assignment），代替NR_POINT_LIGHTS
+
+#include "camera.glsl"
+#include "lighting.glsl"
+#ifdef CLUSTERED_LIGHTS
+#include "clusters.glsl"
+#endif
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS MAX_POINT_LIGHTS
+#endif
+
+#include "material.glsl"
+
+#ifdef OBJECT_LIGHTS
+// pointLights中影响这个对象的光源下标，前objectLightCount个有效
+uniform ivec4 objectLights;
+uniform int objectLightCount;
+// 聚光灯的范围和光锥是否覆盖这个对象
+uniform bool objectSpotLight;
+#endif
 
 void main()
 {
     // 属性
-    vec3 norm = normalize(Normal);
+    Surface surface = SampleSurface();
     vec3 viewDir = normalize(viewPos - FragPos);
 
+    vec3 result = vec3(0.0);
+#ifdef HAS_DIR_LIGHT
     // 平行光
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    result += CalcDirLight(dirLight, surface, viewDir);
+#endif
+#if defined(OBJECT_LIGHTS)
+    // 影响这个对象的点光源
+    for(int i = 0; i < objectLightCount; i++)
+        result += CalcPointLight(pointLights[objectLights[i]], surface, viewDir);
+#elif NR_POINT_LIGHTS > 0
     // 点光源
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+        result += CalcPointLight(pointLights[i], surface, viewDir);
+#endif
+#ifdef CLUSTERED_LIGHTS
+    // 分簇的点光源
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    result += CalcClusterLights(surface, viewDir, gl_FragCoord.xy, viewDepth);
+#endif
+#ifdef HAS_SPOT_LIGHT
     // 聚光灯
-    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#ifdef OBJECT_LIGHTS
+    if (objectSpotLight)
+#endif
+    result += CalcSpotLight(spotLight, surface, viewDir);
+#endif
 
     FragColor = vec4(result, 1.0);
 }
-
-// 当使用平行光时计算颜色
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(-light.direction);
-    // 漫反射着色
-    float diff = max(dot(normal, lightDir), 0.0);
-    // 反射着色
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // 合并结果
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
-}
-
-// 当使用点光源时计算颜色。
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // 漫反射着色
-    float diff = max(dot(normal, lightDir), 0.0);
-    // 反射着色
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // 衰减
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // 合并结果
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-}
-
-// 当使用聚光灯时计算颜色。
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // 漫反射着色
-    float diff = max(dot(normal, lightDir), 0.0);
-    //  反射着色
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // 衰减
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // 聚光灯强度
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    // 合并结果
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
@@ -2,20 +2,42 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef HAS_NORMAL_MAP
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+#ifdef INSTANCING
+// 每个实例的模型矩阵，占用位置7到10
+layout (location = 7) in mat4 aInstanceModel;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+#ifdef HAS_NORMAL_MAP
+out mat3 TBN;
+#endif
 
+#include "camera.glsl"
+
+#ifndef INSTANCING
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
 
 void main()
 {
+#ifdef INSTANCING
+    mat4 model = aInstanceModel;
+#endif
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
+#ifdef HAS_NORMAL_MAP
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 B = normalize(normalMatrix * aBitangent);
+    TBN = mat3(T, B, normalize(Normal));
+#endif
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,69 @@
+//
+// 视锥体剔除的性能测试：10万到100万个随机包围球/包围盒，每帧剔除耗时
+//
+
+#include <learnopengl/frustum_culling.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int FRAMES = 50;
+
+    struct timing {
+        double min_ms;
+        double average_ms;
+        std::size_t visible;
+    };
+
+    template<class Cull>
+    timing measure(Cull &&cull, std::vector<std::uint32_t> &visible) {
+        timing result{1e9, 0.0, 0};
+        for (int frame = 0; frame < FRAMES; frame++) {
+            visible.clear();
+            const auto start = std::chrono::steady_clock::now();
+            cull(visible);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            result.min_ms = std::min(result.min_ms, elapsed.count());
+            result.average_ms += elapsed.count() / FRAMES;
+        }
+        result.visible = visible.size();
+        return result;
+    }
+
+    void report(const char *kind, std::size_t count, const timing &t) {
+        std::cout << kind << " " << count << ": min " << t.min_ms << " ms, avg " << t.average_ms << " ms, "
+                  << t.visible << " visible" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "frustum culling benchmark (" << culling_instruction_set() << ")" << std::endl;
+    // the demo's camera: 45 degree fov looking down -z from the origin
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 960.0f / 720.0f, 0.1f, 100.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const frustum f = frustum::from_matrix(projection * view);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    std::vector<std::uint32_t> visible;
+    for (std::size_t count: {100000u, 250000u, 500000u, 1000000u}) {
+        sphere_list spheres;
+        aabb_list boxes;
+        for (std::size_t i = 0; i < count; i++) {
+            const glm::vec3 center(position(random), position(random), position(random));
+            const glm::vec3 extent(size(random), size(random), size(random));
+            spheres.add(center, glm::length(extent));
+            boxes.add(aabb{center - extent, center + extent});
+        }
+        report("spheres", count, measure([&](std::vector<std::uint32_t> &v) { cull_spheres(f, spheres, v); }, visible));
+        report("aabbs  ", count, measure([&](std::vector<std::uint32_t> &v) { cull_aabbs(f, boxes, v); }, visible));
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+//
+// 软件遮挡剔除的性能测试：一面遮挡墙后面的大量包围盒
+//
+
+#include <learnopengl/occlusion_culling.h>
+#include <learnopengl/vertices.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int FRAMES = 50;
+
+    double milliseconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main() {
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 960.0f / 720.0f, 0.1f, 100.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const frustum f = frustum::from_matrix(projection * view);
+
+    // a wall of 7 x 5 boxes at z = -10 with gaps between them, the demo's cube as occluder mesh
+    std::vector<glm::mat4> occluders;
+    for (int x = -3; x <= 3; x++) {
+        for (int y = -2; y <= 2; y++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x * 1.5f, y * 1.5f, -10.0f));
+            occluders.push_back(glm::scale(model, glm::vec3(1.4f, 1.4f, 0.5f)));
+        }
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.0f);
+    for (std::size_t count: {10000u, 100000u}) {
+        aabb_list boxes;
+        for (std::size_t i = 0; i < count; i++) {
+            const glm::vec3 center(position(random), position(random), position(random) * 0.5f - 50.0f);
+            const glm::vec3 extent(size(random));
+            boxes.add(aabb{center - extent, center + extent});
+        }
+        std::vector<std::uint32_t> visible;
+        cull_aabbs(f, boxes, visible);
+        const std::size_t inFrustum = visible.size();
+
+        occlusion_buffer occlusion;
+        double rasterizeMs = 0.0, testMs = 0.0;
+        std::vector<std::uint32_t> unoccluded;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            occlusion.begin_frame(projection * view);
+            for (const auto &model: occluders)
+                occlusion.add_triangles(vertices, 8, 36, model);
+            occlusion.rasterize();
+            rasterizeMs += milliseconds_since(start) / FRAMES;
+            start = std::chrono::steady_clock::now();
+            unoccluded = visible;
+            occlusion.filter(boxes, unoccluded);
+            testMs += milliseconds_since(start) / FRAMES;
+        }
+        std::cout << count << " boxes, " << occlusion.width() << "x" << occlusion.height() << " buffer, "
+                  << occlusion.triangle_count() << " occluder triangles: rasterize " << rasterizeMs << " ms, test "
+                  << testMs << " ms, " << inFrustum << " in frustum, " << unoccluded.size() << " unoccluded"
+                  << std::endl;
+    }
+    return 0;
+}
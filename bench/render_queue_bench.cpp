@@ -0,0 +1,149 @@
+//
+// 渲染队列的性能测试：并行录制命令列表的耗时，并检查多个列表回放的绘制与单个列表完全相同
+//
+
+#include <learnopengl/render_queue.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int FRAMES = 50;
+    constexpr std::size_t PROGRAMS = 8;
+    constexpr std::size_t MATERIALS = 16;
+    constexpr GLuint VERTEX_ARRAYS = 4;
+
+    // a draw as the GL thread would issue it, with the state in effect at that point
+    struct issued_draw {
+        const Shader *shader;
+        const material *mat;
+        GLuint vao;
+        GLint first;
+        GLsizei count;
+        std::vector<glm::mat4> models;
+
+        bool operator==(const issued_draw &other) const {
+            return shader == other.shader && mat == other.mat && vao == other.vao && first == other.first &&
+                   count == other.count && models == other.models;
+        }
+    };
+
+    // walks the lists like command_list::replay, without GL
+    std::vector<issued_draw> issued_draws(const render_queue &queue, std::size_t lists) {
+        std::vector<issued_draw> draws;
+        for (std::size_t list = 0; list < lists; list++) {
+            const command_list &commands = queue.recorded(list);
+            issued_draw state{nullptr, nullptr, 0, 0, 0, {}};
+            std::size_t model = 0, instances = 0;
+            for (const recorded_command &command: commands.recorded()) {
+                switch (command.op) {
+                    case command_op::use_program:
+                        state.shader = command.shader;
+                        break;
+                    case command_op::bind_material:
+                        state.mat = command.mat;
+                        break;
+                    case command_op::bind_vertex_array:
+                        state.vao = command.vao;
+                        break;
+                    case command_op::set_model:
+                        model = command.data;
+                        break;
+                    case command_op::set_lights:
+                        break;
+                    case command_op::set_instance_range:
+                        instances = command.data / sizeof(glm::mat4);
+                        break;
+                    case command_op::draw: {
+                        issued_draw draw = state;
+                        draw.first = command.first;
+                        draw.count = command.count;
+                        if (command.instances > 1) {
+                            const auto from = commands.instance_data().begin() + static_cast<std::ptrdiff_t>(instances);
+                            draw.models.assign(from, from + command.instances);
+                        } else {
+                            draw.models.push_back(commands.model_data()[model]);
+                        }
+                        draws.push_back(std::move(draw));
+                        break;
+                    }
+                }
+            }
+        }
+        return draws;
+    }
+
+    double milliseconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main() {
+    // Shader only asks GL for its active uniforms when it is made from a finished program; without a context
+    // the answer is none
+    glad_glGetProgramiv = [](GLuint, GLenum, GLint *params) { *params = 0; };
+    std::vector<std::unique_ptr<Shader>> programs;
+    for (std::size_t i = 0; i < 2 * PROGRAMS; i++) {
+        pending_program pending;
+        pending.program = static_cast<GLuint>(i + 1);
+        programs.push_back(std::make_unique<Shader>(pending));
+    }
+    std::vector<material> materials;
+    for (std::size_t i = 0; i < MATERIALS; i++) {
+        std::array<GLuint, TEXTURE_ROLE_COUNT> textures{};
+        textures[0] = static_cast<GLuint>(i + 1);
+        materials.emplace_back(textures);
+    }
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::mt19937 random(7);
+    std::uniform_int_distribution<std::size_t> program(0, PROGRAMS - 1);
+    std::uniform_int_distribution<std::size_t> materialIndex(0, MATERIALS - 1);
+    std::uniform_int_distribution<GLuint> vertexArray(1, VERTEX_ARRAYS);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    bool same = true;
+    for (std::size_t count: {1000u, 10000u, 100000u}) {
+        render_queue queue;
+        queue.begin_frame(view, 100.0f);
+        for (std::size_t i = 0; i < count; i++) {
+            draw_command command;
+            const std::size_t p = program(random);
+            command.shader = programs[p].get();
+            // half of the programs have an instanced variant, so runs of their draws become one instanced call
+            command.instanced = p % 2 == 0 ? programs[PROGRAMS + p].get() : nullptr;
+            command.vao = vertexArray(random);
+            command.count = 36;
+            command.mat = &materials[materialIndex(random)];
+            command.model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), -50.0f));
+            queue.submit(render_pass::opaque, command);
+        }
+        queue.sort();
+
+        queue.set_max_lists(1);
+        queue.record(render_pass::opaque);
+        const std::vector<issued_draw> serial = issued_draws(queue, 1);
+        for (std::size_t maxLists: {1u, 2u, 4u, 8u}) {
+            queue.set_max_lists(maxLists);
+            std::size_t lists = 0;
+            double recordMs = 1e9;
+            for (int frame = 0; frame < FRAMES; frame++) {
+                const auto start = std::chrono::steady_clock::now();
+                lists = queue.record(render_pass::opaque);
+                recordMs = std::min(recordMs, milliseconds_since(start));
+            }
+            const bool matches = issued_draws(queue, lists) == serial;
+            same = same && matches;
+            std::cout << count << " draws, " << lists << " lists: record min " << recordMs << " ms, " << serial.size()
+                      << " calls, " << (matches ? "same draws as one list" : "DRAWS DIFFER FROM ONE LIST")
+                      << std::endl;
+        }
+    }
+    return same ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+// 每帧更新一次，所有程序共享（与uniform_blocks.h中的camera_block一致）
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
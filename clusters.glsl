@@ -0,0 +1,58 @@
+// 分簇光照的数据（与light_clusters.h一致），使用前需要包含lighting.glsl
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+// 每个光源4个texel，布局与PointLight相同，最后一个texel的w是光源半径
+uniform samplerBuffer clusterLights;
+// 每个簇：(索引列表中的起点, 光源数量)
+uniform usamplerBuffer clusterGrid;
+// 所有簇的光源编号
+uniform usamplerBuffer clusterIndices;
+// xy: 每个像素对应的簇数，zw: 深度切片 = log(深度) * z + w
+uniform vec4 clusterParams;
+
+// 片段所在的簇，viewDepth是片段到相机平面的距离
+int ClusterIndex(vec2 fragCoord, float viewDepth)
+{
+    ivec3 cluster;
+    cluster.xy = ivec2(fragCoord * clusterParams.xy);
+    cluster.z = int(floor(log(max(viewDepth, 1e-4)) * clusterParams.z + clusterParams.w));
+    cluster = clamp(cluster, ivec3(0), ivec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));
+    return cluster.x + CLUSTER_X * (cluster.y + CLUSTER_Y * cluster.z);
+}
+
+PointLight FetchClusterLight(int index, out float radius)
+{
+    vec4 t0 = texelFetch(clusterLights, index * 4);
+    vec4 t1 = texelFetch(clusterLights, index * 4 + 1);
+    vec4 t2 = texelFetch(clusterLights, index * 4 + 2);
+    vec4 t3 = texelFetch(clusterLights, index * 4 + 3);
+    PointLight light;
+    light.position = t0.xyz;
+    light.constant = t0.w;
+    light.ambient = t1.xyz;
+    light.linear = t1.w;
+    light.diffuse = t2.xyz;
+    light.quadratic = t2.w;
+    light.specular = t3.xyz;
+    radius = t3.w;
+    return light;
+}
+
+// 片段所在簇中所有点光源的贡献。光照在半径处平滑地降到0，簇的边界不会出现接缝
+vec3 CalcClusterLights(Surface surface, vec3 viewDir, vec2 fragCoord, float viewDepth)
+{
+    uvec2 range = texelFetch(clusterGrid, ClusterIndex(fragCoord, viewDepth)).xy;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        float radius;
+        PointLight light = FetchClusterLight(index, radius);
+        float ratio = length(light.position - surface.position) / radius;
+        float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+        result += window * window * CalcPointLight(light, surface, viewDir);
+    }
+    return result;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// 几何阶段：只采样材质，把表面属性写入G缓冲，光照在deferred_lighting.fs中计算
+// 变体宏与6.multiple_lights.fs相同，光源相关的宏在这里没有作用
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec2 gNormal;
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+#include "material.glsl"
+
+void main()
+{
+    Surface surface = SampleSurface();
+    gAlbedoSpec = vec4(surface.albedo, surface.specularMask);
+    gNormal = EncodeNormal(surface.normal);
+}
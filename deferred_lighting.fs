@@ -0,0 +1,68 @@
+#version 330 core
+out vec4 FragColor;
+
+// 光照阶段：每个像素从G缓冲读取一次表面属性，再计算光照
+// 变体宏: NR_POINT_LIGHTS, HAS_DIR_LIGHT, HAS_SPOT_LIGHT, CLUSTERED_LIGHTS（见6.multiple_lights.fs）
+
+#include "camera.glsl"
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+#ifdef CLUSTERED_LIGHTS
+#include "clusters.glsl"
+#endif
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS MAX_POINT_LIGHTS
+#endif
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+// 从深度重建世界空间位置；动态分辨率下只用到G缓冲左下角viewportSize大小的区域
+uniform mat4 inverseViewProjection;
+uniform vec2 viewportSize;
+// G缓冲中没有光泽度，场景中的材质共用一个值
+uniform float shininess;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // 没有几何体的像素保留清屏颜色
+    if (depth == 1.0)
+        discard;
+
+    vec2 uv = gl_FragCoord.xy / viewportSize;
+    vec4 position = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+
+    Surface surface;
+    surface.position = position.xyz / position.w;
+    surface.normal = DecodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    surface.albedo = albedoSpec.rgb;
+    surface.specularMask = albedoSpec.a;
+    surface.shininess = shininess;
+    vec3 viewDir = normalize(viewPos - surface.position);
+
+    vec3 result = vec3(0.0);
+#ifdef HAS_DIR_LIGHT
+    result += CalcDirLight(dirLight, surface, viewDir);
+#endif
+#if NR_POINT_LIGHTS > 0
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], surface, viewDir);
+#endif
+#ifdef CLUSTERED_LIGHTS
+    // 与前向着色使用同一个簇网格
+    float viewDepth = -(view * vec4(surface.position, 1.0)).z;
+    result += CalcClusterLights(surface, viewDir, gl_FragCoord.xy, viewDepth);
+#endif
+#ifdef HAS_SPOT_LIGHT
+    result += CalcSpotLight(spotLight, surface, viewDir);
+#endif
+
+    FragColor = vec4(result, 1.0);
+    // 写回场景深度，之后前向绘制的物体（光源立方体、模型）照常做深度测试
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,7 @@
+#version 330 core
+// 覆盖整个屏幕的三角形，不需要顶点缓冲
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
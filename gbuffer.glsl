@@ -0,0 +1,24 @@
+// G缓冲的格式（与g_buffer.h一致）:
+// 0  RGBA8   rgb: 漫反射颜色, a: 镜面反射遮罩
+// 1  RG16F   八面体编码的世界空间法线
+//    深度纹理，用来重建位置
+
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// 单位法线投影到八面体上再展开成正方形，两个分量就够了
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+}
+
+vec3 DecodeNormal(vec2 f)
+{
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
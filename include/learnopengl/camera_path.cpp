@@ -0,0 +1,139 @@
+//
+// 相机路径：记录相机输入和发生的时间，按固定步长回放，用于可重复的性能测试
+//
+
+#include "camera_path.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace {
+    // first line of every file, so that a wrong file is rejected instead of replayed as nonsense
+    const char *const HEADER = "camera_path 1";
+}
+
+void camera_path::start(const Camera &camera) {
+    startPosition = camera.Position;
+    startYaw = camera.Yaw;
+    startPitch = camera.Pitch;
+    startZoom = camera.Zoom;
+    inputs.clear();
+    next = 0;
+}
+
+void camera_path::record_keyboard(double time, Camera_Movement direction, float deltaTime) {
+    inputs.push_back(input{std::max(time, duration()), input_kind::keyboard, direction, deltaTime, 0.0f});
+}
+
+void camera_path::record_mouse(double time, float xoffset, float yoffset) {
+    inputs.push_back(input{std::max(time, duration()), input_kind::mouse, FORWARD, xoffset, yoffset});
+}
+
+void camera_path::record_scroll(double time, float yoffset) {
+    inputs.push_back(input{std::max(time, duration()), input_kind::scroll, FORWARD, 0.0f, yoffset});
+}
+
+bool camera_path::save(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    // enough digits to read back the same float and double
+    file.precision(std::numeric_limits<double>::max_digits10);
+    file << HEADER << '\n';
+    file << "start " << startPosition.x << ' ' << startPosition.y << ' ' << startPosition.z << ' ' << startYaw << ' '
+         << startPitch << ' ' << startZoom << '\n';
+    for (const auto &i: inputs) {
+        switch (i.kind) {
+            case input_kind::keyboard:
+                file << "k " << i.time << ' ' << static_cast<int>(i.direction) << ' ' << i.x << '\n';
+                break;
+            case input_kind::mouse:
+                file << "m " << i.time << ' ' << i.x << ' ' << i.y << '\n';
+                break;
+            case input_kind::scroll:
+                file << "s " << i.time << ' ' << i.y << '\n';
+                break;
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+void camera_path::load(const std::string &path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::string("ERROR::CAMERA_PATH:: can't open ") + path;
+    std::string line;
+    if (!std::getline(file, line) || line != HEADER)
+        throw std::string("ERROR::CAMERA_PATH:: not a camera path: ") + path;
+
+    std::vector<input> loaded;
+    glm::vec3 position{0.0f};
+    float yaw = YAW, pitch = PITCH, zoom = ZOOM;
+    int lineNumber = 1;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty())
+            continue;
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        input i{0.0, input_kind::keyboard, FORWARD, 0.0f, 0.0f};
+        if (kind == "start") {
+            fields >> position.x >> position.y >> position.z >> yaw >> pitch >> zoom;
+        } else if (kind == "k") {
+            int direction = 0;
+            fields >> i.time >> direction >> i.x;
+            if (direction < FORWARD || direction > RIGHT)
+                fields.setstate(std::ios::failbit);
+            i.direction = static_cast<Camera_Movement>(direction);
+        } else if (kind == "m") {
+            i.kind = input_kind::mouse;
+            fields >> i.time >> i.x >> i.y;
+        } else if (kind == "s") {
+            i.kind = input_kind::scroll;
+            fields >> i.time >> i.y;
+        } else {
+            fields.setstate(std::ios::failbit);
+        }
+        if (!fields || (!loaded.empty() && kind != "start" && i.time < loaded.back().time))
+            throw std::string("ERROR::CAMERA_PATH:: bad input at ") + path + ":" + std::to_string(lineNumber);
+        if (kind != "start")
+            loaded.push_back(i);
+    }
+
+    startPosition = position;
+    startYaw = yaw;
+    startPitch = pitch;
+    startZoom = zoom;
+    inputs = std::move(loaded);
+    next = 0;
+}
+
+void camera_path::rewind(Camera &camera) {
+    camera.Position = startPosition;
+    camera.Yaw = startYaw;
+    camera.Pitch = startPitch;
+    camera.Zoom = startZoom;
+    // recomputes Front, Right and Up from the angles
+    camera.ProcessMouseMovement(0.0f, 0.0f);
+    next = 0;
+}
+
+void camera_path::replay_until(Camera &camera, double time) {
+    for (; next < inputs.size() && inputs[next].time <= time; next++) {
+        const input &i = inputs[next];
+        switch (i.kind) {
+            case input_kind::keyboard:
+                camera.ProcessKeyboard(i.direction, i.x);
+                break;
+            case input_kind::mouse:
+                camera.ProcessMouseMovement(i.x, i.y);
+                break;
+            case input_kind::scroll:
+                camera.ProcessMouseScroll(i.y);
+                break;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+//
+// 相机路径：记录相机输入和发生的时间，按固定步长回放，用于可重复的性能测试
+//
+
+#ifndef CG_CAMERA_PATH_H
+#define CG_CAMERA_PATH_H
+
+#include <learnopengl/camera.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The inputs a Camera was given (ProcessKeyboard, ProcessMouseMovement, ProcessMouseScroll) with the time of each,
+// in seconds. A recording starts from the camera's state, so replaying it onto any camera retraces the same path:
+// replay_until() applies the inputs up to a time in their recorded order, with their recorded deltaTime, so where
+// the camera is at a given time doesn't depend on how often or how fast frames were drawn.
+// Saved as text, one input per line, with enough digits that a loaded path replays bit for bit.
+class camera_path {
+public:
+    // forgets all inputs and remembers where the camera starts
+    void start(const Camera &camera);
+    // an input recorded with an earlier time than the one before it gets that one's time
+    void record_keyboard(double time, Camera_Movement direction, float deltaTime);
+    void record_mouse(double time, float xoffset, float yoffset);
+    void record_scroll(double time, float yoffset);
+
+    bool save(const std::string &path) const;
+    // throws a std::string if the file can't be read or isn't a camera path
+    void load(const std::string &path);
+
+    // puts the camera at the start of the path and replays from the beginning
+    void rewind(Camera &camera);
+    // applies the inputs up to and including time; times must not decrease between calls
+    void replay_until(Camera &camera, double time);
+    bool finished() const { return next == inputs.size(); }
+
+    // time of the last input
+    double duration() const { return inputs.empty() ? 0.0 : inputs.back().time; }
+    std::size_t size() const { return inputs.size(); }
+
+private:
+    enum class input_kind {
+        keyboard, mouse, scroll
+    };
+    struct input {
+        double time;
+        input_kind kind;
+        Camera_Movement direction;
+        // keyboard: deltaTime; mouse: x and y offset; scroll: y offset
+        float x;
+        float y;
+    };
+
+    glm::vec3 startPosition{0.0f};
+    float startYaw = YAW;
+    float startPitch = PITCH;
+    float startZoom = ZOOM;
+    std::vector<input> inputs;
+    std::size_t next = 0;
+};
+
+
+#endif //CG_CAMERA_PATH_H
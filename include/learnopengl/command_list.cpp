@@ -0,0 +1,151 @@
+//
+// 命令列表：工作线程并行录制绘制命令（不调用OpenGL），由GL线程按顺序回放
+//
+
+#include "command_list.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "profiler.h"
+
+#include <cstring>
+
+void command_list::clear() {
+    commands.clear();
+    models.clear();
+    lights.clear();
+    instanceData.clear();
+}
+
+void command_list::use_program(const Shader *shader) {
+    recorded_command command{command_op::use_program};
+    command.shader = shader;
+    commands.push_back(command);
+}
+
+void command_list::bind_material(const material *mat, const Shader *shader) {
+    recorded_command command{command_op::bind_material};
+    command.mat = mat;
+    command.shader = shader;
+    commands.push_back(command);
+}
+
+void command_list::bind_vertex_array(GLuint vao) {
+    recorded_command command{command_op::bind_vertex_array};
+    command.vao = vao;
+    commands.push_back(command);
+}
+
+void command_list::set_model(const Shader *shader, const glm::mat4 &model) {
+    recorded_command command{command_op::set_model};
+    command.shader = shader;
+    command.data = models.size();
+    models.push_back(model);
+    commands.push_back(command);
+}
+
+void command_list::set_lights(const Shader *shader, const object_lights &objectLights) {
+    recorded_command command{command_op::set_lights};
+    command.shader = shader;
+    command.data = lights.size();
+    lights.push_back(objectLights);
+    commands.push_back(command);
+}
+
+glm::mat4 *command_list::set_instance_range(std::size_t count) {
+    recorded_command command{command_op::set_instance_range};
+    command.data = instanceData.size() * sizeof(glm::mat4);
+    instanceData.resize(instanceData.size() + count);
+    commands.push_back(command);
+    return instanceData.data() + instanceData.size() - count;
+}
+
+void command_list::draw(GLenum mode, bool indexed, GLint first, GLsizei count, GLsizei instances) {
+    recorded_command command{command_op::draw};
+    command.mode = mode;
+    command.indexed = indexed;
+    command.first = first;
+    command.count = count;
+    command.instances = instances;
+    commands.push_back(command);
+}
+
+void command_list::replay(ring_buffer *ring, GLuint &fallbackBuffer) const {
+    auto &state = gl_state::instance();
+    // the instance data goes to the GPU in one piece; set_instance_range offsets are relative to its start
+    const std::size_t bytes = instanceData.size() * sizeof(glm::mat4);
+    GLuint buffer = 0;
+    GLintptr base = 0;
+    if (bytes > 0) {
+        ring_allocation allocation;
+        if (ring)
+            allocation = ring->allocate(bytes, sizeof(glm::vec4));
+        if (allocation.data) {
+            std::memcpy(allocation.data, instanceData.data(), bytes);
+            ring->commit(allocation);
+            buffer = allocation.buffer;
+            base = allocation.offset;
+        } else {
+            if (fallbackBuffer == 0)
+                glGenBuffers(1, &fallbackBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, fallbackBuffer);
+            // orphan the previous list's matrices instead of waiting for the draws that read it
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes), instanceData.data(), GL_STREAM_DRAW);
+            buffer = fallbackBuffer;
+        }
+    }
+
+    // every run of draws with one program is a GPU scope of the profiler
+    auto &profile = profiler::instance();
+    bool inGroup = false;
+    for (const auto &command: commands) {
+        switch (command.op) {
+            case command_op::use_program:
+                if (inGroup)
+                    profile.end_gpu();
+                inGroup = profile.is_enabled();
+                if (inGroup)
+                    profile.begin_gpu(command.shader->profileName);
+                command.shader->use();
+                break;
+            case command_op::bind_material:
+                command.mat->bind(*command.shader);
+                break;
+            case command_op::bind_vertex_array:
+                state.bind_vertex_array(command.vao);
+                break;
+            case command_op::set_model:
+                command.shader->setMat4("model"_u, models[command.data]);
+                break;
+            case command_op::set_lights:
+                lights[command.data].bind(*command.shader);
+                break;
+            case command_op::set_instance_range:
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                // a mat4 attribute takes four locations, one column each; the vertex array is already bound
+                for (GLuint column = 0; column < 4; column++) {
+                    const GLuint attribute = INSTANCE_MODEL_ATTRIBUTE + column;
+                    glEnableVertexAttribArray(attribute);
+                    glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                          reinterpret_cast<void *>(base + command.data + column * sizeof(glm::vec4)));
+                    glVertexAttribDivisor(attribute, 1);
+                }
+                break;
+            case command_op::draw:
+                if (command.instances > 1) {
+                    if (command.indexed)
+                        glDrawElementsInstanced(command.mode, command.count, GL_UNSIGNED_INT, nullptr,
+                                                command.instances);
+                    else
+                        glDrawArraysInstanced(command.mode, command.first, command.count, command.instances);
+                } else {
+                    if (command.indexed)
+                        glDrawElements(command.mode, command.count, GL_UNSIGNED_INT, nullptr);
+                    else
+                        glDrawArrays(command.mode, command.first, command.count);
+                }
+                break;
+        }
+    }
+    if (inGroup)
+        profile.end_gpu();
+}
@@ -0,0 +1,81 @@
+//
+// 命令列表：工作线程并行录制绘制命令（不调用OpenGL），由GL线程按顺序回放
+//
+
+#ifndef CG_COMMAND_LIST_H
+#define CG_COMMAND_LIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/material.h>
+#include <learnopengl/ring_buffer.h>
+#include <learnopengl/light_assignment.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class command_op : std::uint8_t {
+    use_program,
+    bind_material,
+    bind_vertex_array,
+    // the model uniform, from the list's data
+    set_model,
+    // the per-draw light list, from the list's data
+    set_lights,
+    // points the instance attributes at matrices in the list's data
+    set_instance_range,
+    draw,
+};
+
+struct recorded_command {
+    command_op op;
+    bool indexed = false;
+    GLenum mode = GL_TRIANGLES;
+    const Shader *shader = nullptr;
+    const material *mat = nullptr;
+    GLuint vao = 0;
+    GLint first = 0;
+    GLsizei count = 0;
+    GLsizei instances = 1;
+    // set_model: index into the list's models; set_lights: index into its light lists; set_instance_range: byte offset into its instance data
+    std::size_t data = 0;
+};
+
+// A recorded sequence of state changes and draws. Recording only appends to vectors, so any thread can fill its own
+// list; matrices are copied into the list. replay() must run on the GL thread: it copies the instance matrices into the
+// frame ring (or an orphaned buffer without one) in one piece and then issues the commands in order.
+class command_list {
+public:
+    void clear();
+
+    void use_program(const Shader *shader);
+    // the program must be the one used last
+    void bind_material(const material *mat, const Shader *shader);
+    void bind_vertex_array(GLuint vao);
+    void set_model(const Shader *shader, const glm::mat4 &model);
+    void set_lights(const Shader *shader, const object_lights &lights);
+    // room for count matrices read by the next instanced draw; the pointer is valid until the next record call
+    glm::mat4 *set_instance_range(std::size_t count);
+    void draw(GLenum mode, bool indexed, GLint first, GLsizei count, GLsizei instances = 1);
+
+    std::size_t size() const { return commands.size(); }
+    // what was recorded, to inspect a list without replaying it: set_model indexes models(), set_instance_range
+    // offsets are into instance_data()
+    const std::vector<recorded_command> &recorded() const { return commands; }
+    const std::vector<glm::mat4> &model_data() const { return models; }
+    const std::vector<glm::mat4> &instance_data() const { return instanceData; }
+
+    // fallbackBuffer is created on demand and reused by later replays
+    void replay(ring_buffer *ring, GLuint &fallbackBuffer) const;
+
+private:
+    std::vector<recorded_command> commands;
+    std::vector<glm::mat4> models;
+    std::vector<object_lights> lights;
+    std::vector<glm::mat4> instanceData;
+};
+
+
+#endif //CG_COMMAND_LIST_H
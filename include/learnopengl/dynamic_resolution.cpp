@@ -0,0 +1,173 @@
+//
+// 动态分辨率：场景渲染到按比例缩小的离屏目标，根据GPU时间调整比例，再放大到窗口
+//
+
+#include "dynamic_resolution.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // weight of a new timing in the smoothed time
+    constexpr float SMOOTHING = 0.1f;
+    // relative distance from the target in which the scale is left alone
+    constexpr float DEADBAND = 0.05f;
+    // fraction of the way to the estimated scale taken per timing
+    constexpr float GAIN = 0.25f;
+    // longer timings are ignored; llvmpipe reports nonsense for the first query of a context
+    constexpr float MAX_TIMING_MS = 1000.0f;
+}
+
+dynamic_resolution::dynamic_resolution() {
+    glGenQueries(QUERY_COUNT, queries);
+    glGenVertexArrays(1, &emptyVAO);
+    upscaleShader = std::make_unique<Shader>("../deferred_lighting.vs", "../upscale.fs");
+    upscaleShader->use();
+    upscaleShader->setInt("scene"_u, static_cast<int>(UPSCALE_SOURCE_UNIT));
+}
+
+dynamic_resolution::~dynamic_resolution() {
+    release();
+    glDeleteQueries(QUERY_COUNT, queries);
+    auto &state = gl_state::instance();
+    state.forget_vertex_array(emptyVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+    state.forget_program(upscaleShader->ID);
+    glDeleteProgram(upscaleShader->ID);
+}
+
+void dynamic_resolution::set_scale_range(float minimum, float maximum) {
+    maxScale = std::min(std::max(maximum, 0.1f), 2.0f);
+    minScale = std::min(std::max(minimum, 0.1f), maxScale);
+    currentScale = std::min(std::max(currentScale, minScale), maxScale);
+    // the target is sized for the maximum scale
+    windowWidth = windowHeight = 0;
+}
+
+void dynamic_resolution::release() {
+    if (color != 0) {
+        gl_state::instance().forget_texture(color);
+        glDeleteTextures(1, &color);
+    }
+    if (depth != 0)
+        glDeleteRenderbuffers(1, &depth);
+    if (fbo != 0)
+        glDeleteFramebuffers(1, &fbo);
+    fbo = color = depth = 0;
+    targetWidth = targetHeight = 0;
+}
+
+void dynamic_resolution::resize(int width, int height) {
+    if (width == windowWidth && height == windowHeight)
+        return;
+    release();
+    windowWidth = width;
+    windowHeight = height;
+    if (width <= 0 || height <= 0)
+        return; // minimised window
+    targetWidth = static_cast<int>(std::ceil(static_cast<float>(width) * maxScale));
+    targetHeight = static_cast<int>(std::ceil(static_cast<float>(height) * maxScale));
+
+    glGenTextures(1, &color);
+    gl_state::instance().bind_texture(UPSCALE_SOURCE_UNIT, GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, targetWidth, targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: dynamic resolution target is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void dynamic_resolution::begin_frame(int width, int height) {
+    // finished timings move the scale before this frame's size is chosen
+    read_queries();
+    resize(width, height);
+    if (!enabled)
+        currentScale = maxScale;
+    renderWidth = std::max(1, static_cast<int>(std::lround(static_cast<float>(width) * currentScale)));
+    renderHeight = std::max(1, static_cast<int>(std::lround(static_cast<float>(height) * currentScale)));
+    renderWidth = std::min(renderWidth, std::max(targetWidth, 1));
+    renderHeight = std::min(renderHeight, std::max(targetHeight, 1));
+    bind();
+}
+
+void dynamic_resolution::begin_timing() {
+    // all queries still in flight: skip timing this frame instead of waiting
+    timing = count < QUERY_COUNT;
+    if (timing)
+        glBeginQuery(GL_TIME_ELAPSED, queries[(first + count) % QUERY_COUNT]);
+}
+
+void dynamic_resolution::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void dynamic_resolution::end_frame() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (fbo != 0)
+        upscale();
+    if (timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        count++;
+        timing = false;
+    }
+}
+
+void dynamic_resolution::upscale() {
+    glViewport(0, 0, windowWidth, windowHeight);
+    auto &state = gl_state::instance();
+    upscaleShader->use();
+    const float scaleX = static_cast<float>(renderWidth) / static_cast<float>(targetWidth);
+    const float scaleY = static_cast<float>(renderHeight) / static_cast<float>(targetHeight);
+    upscaleShader->setVec2("screenSize"_u, static_cast<float>(windowWidth), static_cast<float>(windowHeight));
+    upscaleShader->setVec2("uvScale"_u, scaleX, scaleY);
+    upscaleShader->setVec2("uvMax"_u, scaleX - 0.5f / static_cast<float>(targetWidth),
+                           scaleY - 0.5f / static_cast<float>(targetHeight));
+    state.bind_texture(UPSCALE_SOURCE_UNIT, GL_TEXTURE_2D, color);
+    state.bind_vertex_array(emptyVAO);
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void dynamic_resolution::read_queries() {
+    while (count > 0) {
+        const GLuint query = queries[first];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        first = (first + 1) % QUERY_COUNT;
+        count--;
+        update_scale(static_cast<float>(nanoseconds) * 1e-6f);
+    }
+}
+
+void dynamic_resolution::update_scale(float milliseconds) {
+    if (milliseconds > MAX_TIMING_MS)
+        return;
+    smoothedMs = smoothedMs <= 0.0f ? milliseconds : smoothedMs + (milliseconds - smoothedMs) * SMOOTHING;
+    if (!enabled || smoothedMs <= 0.0f)
+        return;
+    const float ratio = targetMs / smoothedMs;
+    if (std::abs(ratio - 1.0f) < DEADBAND)
+        return;
+    // the cost of a frame is roughly proportional to its pixels, i.e. to the square of the scale
+    const float estimate = currentScale * std::sqrt(ratio);
+    currentScale = std::min(std::max(currentScale + (estimate - currentScale) * GAIN, minScale), maxScale);
+}
@@ -0,0 +1,95 @@
+//
+// 动态分辨率：场景渲染到按比例缩小的离屏目标，根据GPU时间调整比例，再放大到窗口
+//
+
+#ifndef CG_DYNAMIC_RESOLUTION_H
+#define CG_DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader_m.h>
+
+#include <memory>
+
+// texture unit the upscale pass reads the scene from
+constexpr GLuint UPSCALE_SOURCE_UNIT = 0;
+
+// The scene is drawn into the lower left width() x height() of an offscreen target (RGBA8 colour, 24 bit depth)
+// that has the size of the window's framebuffer at the maximum scale, so changing the scale never reallocates.
+// GL_TIME_ELAPSED queries time everything between begin_timing() and end_frame(); there are a few of them in flight
+// and a result is only read once it is available, so timing never waits for the GPU. Timing starts separately from
+// begin_frame() so that the frame's CPU work (culling, sorting, ...) can run in between without being counted:
+// while it runs the GPU sits idle, and the elapsed time would be mostly CPU time. A feedback controller moves
+// the scale towards the target time: pixel cost grows with the area, so the step is towards scale * sqrt(target /
+// time), damped, and nothing changes while the smoothed time is within a small band around the target.
+// end_frame() stretches the rendered region over the default framebuffer with one bilinear fullscreen triangle.
+class dynamic_resolution {
+public:
+    dynamic_resolution();
+    ~dynamic_resolution();
+    dynamic_resolution(const dynamic_resolution &) = delete;
+    dynamic_resolution &operator=(const dynamic_resolution &) = delete;
+
+    // GPU time the scene may take per frame
+    void set_target(float milliseconds) { targetMs = milliseconds; }
+    float get_target() const { return targetMs; }
+    // scale of each axis; maximum may go above 1 for supersampling
+    void set_scale_range(float minimum, float maximum);
+    // when off the scale stays at the maximum, the GPU time is still measured
+    void set_enabled(bool value) { enabled = value; }
+    bool is_enabled() const { return enabled; }
+
+    // feeds finished timings to the controller, (re)creates the target for the window's framebuffer size and binds
+    // it with a viewport of the new scale
+    void begin_frame(int windowWidth, int windowHeight);
+    // starts timing the GPU work; call right before the first draw of the scene
+    void begin_timing();
+    // binds the target and its viewport again, e.g. after the G-buffer pass
+    void bind() const;
+    // draws the target to the default framebuffer and stops timing after it
+    void end_frame();
+
+    float scale() const { return currentScale; }
+    // size of the region the scene is drawn into this frame
+    int width() const { return renderWidth; }
+    int height() const { return renderHeight; }
+    // size of the target's attachments
+    int target_width() const { return targetWidth; }
+    int target_height() const { return targetHeight; }
+    // smoothed GPU time of the scene, 0 until the first query finished
+    float gpu_milliseconds() const { return smoothedMs; }
+
+private:
+    static constexpr int QUERY_COUNT = 4;
+
+    float targetMs = 1000.0f / 60.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    bool enabled = true;
+    float currentScale = 1.0f;
+    float smoothedMs = 0.0f;
+
+    int windowWidth = 0, windowHeight = 0;
+    int targetWidth = 0, targetHeight = 0;
+    int renderWidth = 0, renderHeight = 0;
+
+    GLuint fbo = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    GLuint emptyVAO = 0;
+    std::unique_ptr<Shader> upscaleShader;
+
+    // ring of time queries: the oldest pending one is at first, count are in flight
+    GLuint queries[QUERY_COUNT] = {};
+    int first = 0;
+    int count = 0;
+    bool timing = false;
+
+    void resize(int width, int height);
+    void release();
+    void upscale();
+    void read_queries();
+    void update_scale(float milliseconds);
+};
+
+
+#endif //CG_DYNAMIC_RESOLUTION_H
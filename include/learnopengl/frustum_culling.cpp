@@ -0,0 +1,219 @@
+//
+// 视锥体剔除：从投影*视图矩阵提取六个平面，用SSE/AVX一次测试4/8个包围体
+//
+
+#include "frustum_culling.h"
+#include "simd.h"
+
+#include <cmath>
+
+namespace {
+    // padding volumes sit here with no size, outside every finite frustum
+    constexpr float NOWHERE = 1e18f;
+    constexpr std::size_t PADDING = 8;
+
+    void pad(std::vector<float> &values, std::size_t count, float value) {
+        values.resize((count + PADDING - 1) / PADDING * PADDING, value);
+    }
+
+    template<class Visible>
+    void push_lanes(int mask, std::size_t base, std::size_t count, Visible &visible) {
+        while (mask != 0) {
+            int lane = 0;
+            while (!(mask & (1 << lane)))
+                lane++;
+            mask &= mask - 1;
+            if (base + lane < count)
+                visible.push_back(static_cast<std::uint32_t>(base + lane));
+        }
+    }
+}
+
+aabb aabb::transformed(const glm::mat4 &model) const {
+    // the centre moves with the matrix, the extent through the absolute value of its linear part
+    const glm::vec3 center = glm::vec3(model * glm::vec4((min + max) * 0.5f, 1.0f));
+    const glm::vec3 extent = (max - min) * 0.5f;
+    const glm::mat3 linear(model);
+    const glm::vec3 rotated = glm::abs(linear[0]) * extent.x + glm::abs(linear[1]) * extent.y +
+                              glm::abs(linear[2]) * extent.z;
+    return aabb{center - rotated, center + rotated};
+}
+
+frustum frustum::from_matrix(const glm::mat4 &m) {
+    // rows of the column-major matrix
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    frustum f{};
+    f.planes[0] = row3 + row0; // left
+    f.planes[1] = row3 - row0; // right
+    f.planes[2] = row3 + row1; // bottom
+    f.planes[3] = row3 - row1; // top
+    f.planes[4] = row3 + row2; // near
+    f.planes[5] = row3 - row2; // far
+    for (auto &plane: f.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return f;
+}
+
+void sphere_list::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+    count = 0;
+}
+
+void sphere_list::add(const glm::vec3 &center, float r) {
+    // overwrite the padding, then pad again
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+    count++;
+    pad(x, count, NOWHERE);
+    pad(y, count, NOWHERE);
+    pad(z, count, NOWHERE);
+    pad(radius, count, 0.0f);
+}
+
+void aabb_list::clear() {
+    for (auto *values: {&cx, &cy, &cz, &ex, &ey, &ez})
+        values->clear();
+    count = 0;
+}
+
+void aabb_list::add(const aabb &box) {
+    const glm::vec3 center = (box.min + box.max) * 0.5f;
+    const glm::vec3 extent = (box.max - box.min) * 0.5f;
+    const float values[6] = {center.x, center.y, center.z, extent.x, extent.y, extent.z};
+    std::vector<float> *arrays[6] = {&cx, &cy, &cz, &ex, &ey, &ez};
+    for (int i = 0; i < 6; i++) {
+        arrays[i]->resize(count);
+        arrays[i]->push_back(values[i]);
+    }
+    count++;
+    for (int i = 0; i < 6; i++)
+        pad(*arrays[i], count, i < 3 ? NOWHERE : 0.0f);
+}
+
+void cull_spheres(const frustum &f, const sphere_list &spheres, std::vector<std::uint32_t> &visible) {
+    const std::size_t n = spheres.x.size();
+#if defined(CG_SIMD_AVX)
+    for (std::size_t i = 0; i < n; i += 8) {
+        const __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+        const __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+        const __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+        const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto &plane: f.planes) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        push_lanes(_mm256_movemask_ps(inside), i, spheres.count, visible);
+    }
+#elif defined(CG_SIMD_SSE)
+    for (std::size_t i = 0; i < n; i += 4) {
+        const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto &plane: f.planes) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+            distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        push_lanes(_mm_movemask_ps(inside), i, spheres.count, visible);
+    }
+#else
+    for (std::size_t i = 0; i < spheres.count; i++) {
+        bool inside = true;
+        for (const auto &plane: f.planes) {
+            const float distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+            inside = inside && distance >= -spheres.radius[i];
+        }
+        if (inside)
+            visible.push_back(static_cast<std::uint32_t>(i));
+    }
+    (void) n;
+#endif
+}
+
+void cull_aabbs(const frustum &f, const aabb_list &boxes, std::vector<std::uint32_t> &visible) {
+    // a box is outside if it is completely behind one plane: dot(n, c) + w + dot(|n|, e) < 0
+    const std::size_t n = boxes.cx.size();
+#if defined(CG_SIMD_AVX)
+    for (std::size_t i = 0; i < n; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(&boxes.cx[i]);
+        const __m256 cy = _mm256_loadu_ps(&boxes.cy[i]);
+        const __m256 cz = _mm256_loadu_ps(&boxes.cz[i]);
+        const __m256 ex = _mm256_loadu_ps(&boxes.ex[i]);
+        const __m256 ey = _mm256_loadu_ps(&boxes.ey[i]);
+        const __m256 ez = _mm256_loadu_ps(&boxes.ez[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto &plane: f.planes) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(plane.y)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane.z)));
+            __m256 radius = _mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(plane.x)));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(plane.y))));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z))));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(),
+                                                         _CMP_GE_OQ));
+        }
+        push_lanes(_mm256_movemask_ps(inside), i, boxes.count, visible);
+    }
+#elif defined(CG_SIMD_SSE)
+    for (std::size_t i = 0; i < n; i += 4) {
+        const __m128 cx = _mm_loadu_ps(&boxes.cx[i]);
+        const __m128 cy = _mm_loadu_ps(&boxes.cy[i]);
+        const __m128 cz = _mm_loadu_ps(&boxes.cz[i]);
+        const __m128 ex = _mm_loadu_ps(&boxes.ex[i]);
+        const __m128 ey = _mm_loadu_ps(&boxes.ey[i]);
+        const __m128 ez = _mm_loadu_ps(&boxes.ez[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto &plane: f.planes) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+            __m128 radius = _mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x)));
+            radius = _mm_add_ps(radius, _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y))));
+            radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        push_lanes(_mm_movemask_ps(inside), i, boxes.count, visible);
+    }
+#else
+    for (std::size_t i = 0; i < boxes.count; i++) {
+        bool inside = true;
+        for (const auto &plane: f.planes) {
+            const float distance = plane.x * boxes.cx[i] + plane.y * boxes.cy[i] + plane.z * boxes.cz[i] + plane.w;
+            const float radius = std::fabs(plane.x) * boxes.ex[i] + std::fabs(plane.y) * boxes.ey[i] +
+                                 std::fabs(plane.z) * boxes.ez[i];
+            inside = inside && distance + radius >= 0.0f;
+        }
+        if (inside)
+            visible.push_back(static_cast<std::uint32_t>(i));
+    }
+    (void) n;
+#endif
+}
+
+const char *culling_instruction_set() {
+#if defined(CG_SIMD_AVX)
+    return "AVX";
+#elif defined(CG_SIMD_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
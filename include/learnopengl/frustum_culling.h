@@ -0,0 +1,57 @@
+//
+// 视锥体剔除：从投影*视图矩阵提取六个平面，用SSE/AVX一次测试4/8个包围体
+//
+
+#ifndef CG_FRUSTUM_CULLING_H
+#define CG_FRUSTUM_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // bounds of the box after an affine transform
+    aabb transformed(const glm::mat4 &model) const;
+};
+
+// Planes with inward normals, normalised, so dot(plane.xyz, p) + plane.w is the signed distance of p.
+struct frustum {
+    glm::vec4 planes[6];
+
+    // Gribb/Hartmann extraction from projection * view; the planes are in world space
+    static frustum from_matrix(const glm::mat4 &viewProjection);
+};
+
+// Bounding volumes as structure of arrays, so a test loads 4 (SSE) or 8 (AVX) objects per instruction.
+// The arrays are padded to a multiple of 8 with volumes that are never visible.
+struct sphere_list {
+    std::vector<float> x, y, z, radius;
+    std::size_t count = 0;
+
+    void clear();
+    void add(const glm::vec3 &center, float r);
+};
+
+struct aabb_list {
+    // centre and half extent
+    std::vector<float> cx, cy, cz, ex, ey, ez;
+    std::size_t count = 0;
+
+    void clear();
+    void add(const aabb &box);
+};
+
+// append the indices of the volumes that intersect the frustum to visible, in increasing order
+void cull_spheres(const frustum &f, const sphere_list &spheres, std::vector<std::uint32_t> &visible);
+void cull_aabbs(const frustum &f, const aabb_list &boxes, std::vector<std::uint32_t> &visible);
+
+// the instruction set the culling functions were compiled for: "AVX", "SSE" or "scalar"
+const char *culling_instruction_set();
+
+
+#endif //CG_FRUSTUM_CULLING_H
@@ -0,0 +1,81 @@
+//
+// 延迟着色的G缓冲：漫反射颜色和镜面反射遮罩、八面体编码的法线、深度
+//
+
+#include "g_buffer.h"
+#include "gl_state.h"
+
+#include <iostream>
+
+namespace {
+    GLuint make_target(int width, int height, GLint internalFormat, GLenum format, GLenum type) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        gl_state::instance().bind_texture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        // read with texelFetch, one texel per pixel
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+}
+
+g_buffer::~g_buffer() {
+    release();
+}
+
+void g_buffer::release() {
+    auto &state = gl_state::instance();
+    for (GLuint texture: {albedoSpec, normal, depth}) {
+        if (texture != 0) {
+            state.forget_texture(texture);
+            glDeleteTextures(1, &texture);
+        }
+    }
+    if (fbo != 0)
+        glDeleteFramebuffers(1, &fbo);
+    fbo = albedoSpec = normal = depth = 0;
+}
+
+void g_buffer::resize(int w, int h) {
+    if (w == width && h == height && fbo != 0)
+        return;
+    release();
+    width = w;
+    height = h;
+    if (width <= 0 || height <= 0)
+        return; // minimised window
+
+    albedoSpec = make_target(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    normal = make_target(width, height, GL_RG16F, GL_RG, GL_HALF_FLOAT);
+    depth = make_target(width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpec, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, attachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void g_buffer::bind_for_geometry() const {
+    bind_for_geometry(width, height);
+}
+
+void g_buffer::bind_for_geometry(int viewportWidth, int viewportHeight) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+void g_buffer::bind_textures() const {
+    auto &state = gl_state::instance();
+    state.bind_texture(GBUFFER_ALBEDO_SPEC_UNIT, GL_TEXTURE_2D, albedoSpec);
+    state.bind_texture(GBUFFER_NORMAL_UNIT, GL_TEXTURE_2D, normal);
+    state.bind_texture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D, depth);
+}
@@ -0,0 +1,52 @@
+//
+// 延迟着色的G缓冲：漫反射颜色和镜面反射遮罩、八面体编码的法线、深度
+//
+
+#ifndef CG_G_BUFFER_H
+#define CG_G_BUFFER_H
+
+#include <glad/glad.h>
+
+// texture units the lighting pass reads the G-buffer from (gAlbedoSpec, gNormal, gDepth)
+constexpr GLuint GBUFFER_ALBEDO_SPEC_UNIT = 0;
+constexpr GLuint GBUFFER_NORMAL_UNIT = 1;
+constexpr GLuint GBUFFER_DEPTH_UNIT = 2;
+
+// Framebuffer of the geometry pass, layout in gbuffer.glsl:
+//   0      RGBA8   albedo, specular mask in alpha
+//   1      RG16F   octahedral world space normal
+//   depth  DEPTH_COMPONENT24, position is reconstructed from it
+// 4 + 4 + 3 bytes, 12 per pixel where the driver pads depth to 4, against 24 bytes plus the same depth for the
+// three RGBA16F targets of a position/normal/albedo layout: less than half the bandwidth.
+class g_buffer {
+public:
+    g_buffer() = default;
+    ~g_buffer();
+    g_buffer(const g_buffer &) = delete;
+    g_buffer &operator=(const g_buffer &) = delete;
+
+    // (re)creates the attachments when the size changed
+    void resize(int width, int height);
+    // binds the framebuffer and its viewport for the geometry pass
+    void bind_for_geometry() const;
+    // the same, drawing into the lower left viewportWidth x viewportHeight of the attachments
+    void bind_for_geometry(int viewportWidth, int viewportHeight) const;
+    // binds the attachments to the GBUFFER_*_UNIT units for the lighting pass
+    void bind_textures() const;
+
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+
+private:
+    GLuint fbo = 0;
+    GLuint albedoSpec = 0;
+    GLuint normal = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+
+    void release();
+};
+
+
+#endif //CG_G_BUFFER_H
@@ -0,0 +1,106 @@
+//
+// OpenGL状态跟踪：记住已绑定的程序、VAO、纹理和uniform值，跳过不改变状态的调用
+//
+
+#include "gl_state.h"
+
+#include <cstring>
+
+gl_state &gl_state::instance() {
+    static gl_state state;
+    return state;
+}
+
+void gl_state::use_program(GLuint id) {
+    if (count(call::program, program != id)) {
+        glUseProgram(id);
+        program = id;
+    }
+}
+
+void gl_state::bind_vertex_array(GLuint vao) {
+    if (count(call::vertex_array, vertexArray != vao)) {
+        glBindVertexArray(vao);
+        vertexArray = vao;
+    }
+}
+
+void gl_state::active_texture(GLuint unit) {
+    if (count(call::active_texture, activeUnit != unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+}
+
+void gl_state::bind_texture(GLuint unit, GLenum target, GLuint texture) {
+    if (unit >= TRACKED_UNITS) {
+        active_texture(unit);
+        count(call::texture, true);
+        glBindTexture(target, texture);
+        return;
+    }
+    texture_binding &binding = units[unit];
+    if (count(call::texture, binding.target != target || binding.texture != texture)) {
+        active_texture(unit);
+        glBindTexture(target, texture);
+        binding.target = target;
+        binding.texture = texture;
+    }
+}
+
+bool gl_state::uniform_changed(GLuint id, GLint location, const void *data, std::size_t bytes) {
+    // glUniform* ignores location -1, so there is nothing to send
+    if (location < 0 || bytes > MAX_UNIFORM_BYTES)
+        return count(call::uniform, location >= 0);
+    uniform_value &value = uniforms[id][location];
+    if (!count(call::uniform, value.bytes != bytes || std::memcmp(value.data.data(), data, bytes) != 0))
+        return false;
+    std::memcpy(value.data.data(), data, bytes);
+    value.bytes = bytes;
+    return true;
+}
+
+void gl_state::forget_program(GLuint id) {
+    uniforms.erase(id);
+    if (program == id)
+        program = UNKNOWN;
+}
+
+void gl_state::forget_vertex_array(GLuint vao) {
+    if (vertexArray == vao)
+        vertexArray = UNKNOWN;
+}
+
+void gl_state::forget_texture(GLuint texture) {
+    for (auto &binding: units) {
+        if (binding.texture == texture)
+            binding.texture = UNKNOWN;
+    }
+}
+
+void gl_state::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    units.fill(texture_binding{});
+    // uniform values belong to the program objects and survive binding changes
+}
+
+std::size_t gl_state::issued() const {
+    std::size_t total = 0;
+    for (std::size_t n: issuedCalls)
+        total += n;
+    return total;
+}
+
+std::size_t gl_state::skipped() const {
+    std::size_t total = 0;
+    for (std::size_t n: skippedCalls)
+        total += n;
+    return total;
+}
+
+void gl_state::reset_counters() {
+    issuedCalls.fill(0);
+    skippedCalls.fill(0);
+}
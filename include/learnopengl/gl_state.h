@@ -0,0 +1,83 @@
+//
+// OpenGL状态跟踪：记住已绑定的程序、VAO、纹理和uniform值，跳过不改变状态的调用
+//
+
+#ifndef CG_GL_STATE_H
+#define CG_GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+
+// Shadow copy of the bindings the renderer changes most often. Calls that would set what is already set are
+// skipped and counted. Everything that binds programs, vertex arrays or textures has to go through here, and
+// deleted objects have to be forgotten, because GL reuses names. All functions must be called on the thread that
+// owns the GL context.
+class gl_state {
+public:
+    enum class call {
+        program,
+        vertex_array,
+        active_texture,
+        texture,
+        uniform,
+        count
+    };
+
+    static gl_state &instance();
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vao);
+    void active_texture(GLuint unit);
+    // makes unit active only if the binding actually changes
+    void bind_texture(GLuint unit, GLenum target, GLuint texture);
+    // true if the program's uniform at location doesn't hold these bytes yet; the caller then issues glUniform*.
+    // The value is remembered, so the caller must set it on the program that is in use.
+    bool uniform_changed(GLuint program, GLint location, const void *data, std::size_t bytes);
+
+    void forget_program(GLuint program);
+    void forget_vertex_array(GLuint vao);
+    void forget_texture(GLuint texture);
+    // after GL state was changed without going through the tracker
+    void invalidate();
+
+    std::size_t issued(call c) const { return issuedCalls[static_cast<std::size_t>(c)]; }
+    std::size_t skipped(call c) const { return skippedCalls[static_cast<std::size_t>(c)]; }
+    std::size_t issued() const;
+    std::size_t skipped() const;
+    void reset_counters();
+
+private:
+    static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+    static constexpr std::size_t TRACKED_UNITS = 32;
+    // a mat4 is the largest value set through Shader
+    static constexpr std::size_t MAX_UNIFORM_BYTES = 64;
+
+    struct texture_binding {
+        GLenum target = 0;
+        GLuint texture = UNKNOWN;
+    };
+    struct uniform_value {
+        std::array<unsigned char, MAX_UNIFORM_BYTES> data{};
+        std::size_t bytes = 0;
+    };
+
+    GLuint program = UNKNOWN;
+    GLuint vertexArray = UNKNOWN;
+    GLuint activeUnit = UNKNOWN;
+    std::array<texture_binding, TRACKED_UNITS> units{};
+    std::unordered_map<GLuint, std::unordered_map<GLint, uniform_value>> uniforms;
+
+    std::array<std::size_t, static_cast<std::size_t>(call::count)> issuedCalls{};
+    std::array<std::size_t, static_cast<std::size_t>(call::count)> skippedCalls{};
+
+    bool count(call c, bool issue) {
+        (issue ? issuedCalls : skippedCalls)[static_cast<std::size_t>(c)]++;
+        return issue;
+    }
+};
+
+
+#endif //CG_GL_STATE_H
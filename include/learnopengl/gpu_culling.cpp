@@ -0,0 +1,246 @@
+//
+// GPU驱动的剔除：所有网格放进共享缓冲区，计算着色器做视锥体和Hi-Z剔除并写入间接绘制命令
+//
+
+#include "gpu_culling.h"
+#include "gl_state.h"
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+    constexpr GLuint OBJECTS_BINDING = 0;
+    constexpr GLuint COMMANDS_BINDING = 1;
+    constexpr GLuint COUNTER_BINDING = 2;
+    constexpr GLuint WORKGROUP_SIZE = 64; // local_size_x of gpu_cull.comp
+    // the elements of the planes array, hashed at compile time
+    constexpr uniform_name PLANE_UNIFORMS[6] = {"planes[0]"_u, "planes[1]"_u, "planes[2]"_u,
+                                                "planes[3]"_u, "planes[4]"_u, "planes[5]"_u};
+
+    // DrawElementsIndirectCommand
+    struct draw_elements_indirect {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+}
+
+bool gpu_scene::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+gpu_scene::gpu_scene() {
+    cullShader = std::make_unique<Shader>(Shader::compute("../gpu_cull.comp"));
+    cullShader->use();
+    cullShader->setInt("hiZ"_u, static_cast<int>(GPU_CULL_HIZ_UNIT));
+}
+
+gpu_scene::~gpu_scene() {
+    release_buffers();
+    if (hiZ != 0) {
+        gl_state::instance().forget_texture(hiZ);
+        glDeleteTextures(1, &hiZ);
+    }
+    gl_state::instance().forget_program(cullShader->ID);
+    glDeleteProgram(cullShader->ID);
+}
+
+std::uint32_t gpu_scene::add_geometry(const std::vector<vertex> &geometryVertices,
+                                      const std::vector<std::uint32_t> &geometryIndices) {
+    geometry g{};
+    g.count = static_cast<GLuint>(geometryIndices.size());
+    g.firstIndex = static_cast<GLuint>(indices.size());
+    g.baseVertex = static_cast<GLint>(vertices.size());
+    if (!geometryVertices.empty()) {
+        g.bounds = aabb{geometryVertices[0].position, geometryVertices[0].position};
+        for (const auto &v: geometryVertices) {
+            g.bounds.min = glm::min(g.bounds.min, v.position);
+            g.bounds.max = glm::max(g.bounds.max, v.position);
+        }
+    }
+    vertices.insert(vertices.end(), geometryVertices.begin(), geometryVertices.end());
+    indices.insert(indices.end(), geometryIndices.begin(), geometryIndices.end());
+    geometries.push_back(g);
+    return static_cast<std::uint32_t>(geometries.size() - 1);
+}
+
+std::uint32_t gpu_scene::add_object(std::uint32_t geometryId, const glm::mat4 &model) {
+    const geometry &g = geometries[geometryId];
+    // the sphere around the transformed box
+    const aabb bounds = g.bounds.transformed(model);
+    object_std430 object{};
+    object.sphere = glm::vec4((bounds.min + bounds.max) * 0.5f, glm::length(bounds.max - bounds.min) * 0.5f);
+    object.indexCount = g.count;
+    object.firstIndex = g.firstIndex;
+    object.baseVertex = g.baseVertex;
+    objects.push_back(object);
+    models.push_back(model);
+    return static_cast<std::uint32_t>(objects.size() - 1);
+}
+
+void gpu_scene::release_buffers() {
+    if (vao != 0) {
+        gl_state::instance().forget_vertex_array(vao);
+        glDeleteVertexArrays(1, &vao);
+    }
+    const GLuint buffers[] = {vertexBuffer, indexBuffer, modelBuffer, objectBuffer, commandBuffer, counterBuffer};
+    glDeleteBuffers(6, buffers);
+    vao = vertexBuffer = indexBuffer = modelBuffer = objectBuffer = commandBuffer = counterBuffer = 0;
+}
+
+void gpu_scene::upload() {
+    release_buffers();
+    auto &state = gl_state::instance();
+    glGenVertexArrays(1, &vao);
+    GLuint buffers[6];
+    glGenBuffers(6, buffers);
+    vertexBuffer = buffers[0];
+    indexBuffer = buffers[1];
+    modelBuffer = buffers[2];
+    objectBuffer = buffers[3];
+    commandBuffer = buffers[4];
+    counterBuffer = buffers[5];
+
+    state.bind_vertex_array(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(vertex)), vertices.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(std::uint32_t)),
+                 indices.data(), GL_STATIC_DRAW);
+    // the attributes of mesh::set_up_mesh that the lighting shaders read
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *) offsetof(vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *) offsetof(vertex, tex_coords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *) offsetof(vertex, tangent));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *) offsetof(vertex, bi_tangent));
+    // model matrices, one per instance; baseInstance of each command selects the object's matrix
+    glBindBuffer(GL_ARRAY_BUFFER, modelBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(models.size() * sizeof(glm::mat4)), models.data(),
+                 GL_STATIC_DRAW);
+    for (GLuint column = 0; column < 4; column++) {
+        const GLuint attribute = INSTANCE_MODEL_ATTRIBUTE + column;
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              reinterpret_cast<void *>(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(objects.size() * sizeof(object_std430)),
+                 objects.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(objects.size() * sizeof(draw_elements_indirect)),
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+}
+
+void gpu_scene::upload_hi_z(const occlusion_buffer &occlusion) {
+    // levels are only used while both sides halve exactly, so texel x of level l covers texels
+    // [x << l, (x + 1) << l) of level 0 and the shader can find them with a shift
+    int width = occlusion.width(), height = occlusion.height();
+    int levels = 1;
+    while (width % 2 == 0 && height % 2 == 0 && (width > 1 || height > 1)) {
+        width /= 2;
+        height /= 2;
+        levels++;
+    }
+    auto &state = gl_state::instance();
+    // the storage is only (re)allocated when the occlusion buffer changes size, otherwise it's overwritten
+    const bool allocate = hiZ == 0 || occlusion.width() != hiZWidth || occlusion.height() != hiZHeight;
+    if (allocate) {
+        if (hiZ != 0) {
+            state.forget_texture(hiZ);
+            glDeleteTextures(1, &hiZ);
+        }
+        glGenTextures(1, &hiZ);
+        state.bind_texture(GPU_CULL_HIZ_UNIT, GL_TEXTURE_2D, hiZ);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        hiZLevels = levels;
+        hiZWidth = occlusion.width();
+        hiZHeight = occlusion.height();
+        hiZData.assign(static_cast<std::size_t>(levels), {});
+    }
+    state.bind_texture(GPU_CULL_HIZ_UNIT, GL_TEXTURE_2D, hiZ);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    width = occlusion.width();
+    height = occlusion.height();
+    hiZData[0] = occlusion.depth();
+    for (int level = 0; level < hiZLevels; level++) {
+        if (level > 0) {
+            // farthest of the four texels below
+            const std::vector<float> &below = hiZData[level - 1];
+            std::vector<float> &data = hiZData[level];
+            data.resize(static_cast<std::size_t>(width) * height);
+            const int belowWidth = width * 2;
+            for (int y = 0; y < height; y++) {
+                const float *row0 = &below[static_cast<std::size_t>(2 * y) * belowWidth];
+                const float *row1 = row0 + belowWidth;
+                for (int x = 0; x < width; x++) {
+                    data[static_cast<std::size_t>(y) * width + x] =
+                        std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+                }
+            }
+        }
+        if (allocate)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, hiZData[level].data());
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RED, GL_FLOAT, hiZData[level].data());
+        width /= 2;
+        height /= 2;
+    }
+}
+
+void gpu_scene::cull(const glm::mat4 &viewProjection, const occlusion_buffer *occlusion) {
+    if (objects.empty())
+        return;
+    if (occlusion)
+        upload_hi_z(*occlusion);
+    const frustum f = frustum::from_matrix(viewProjection);
+    cullShader->use();
+    cullShader->setInt("objectCount"_u, static_cast<int>(objects.size()));
+    for (int i = 0; i < 6; i++)
+        cullShader->setVec4(PLANE_UNIFORMS[i], f.planes[i]);
+    cullShader->setMat4("viewProjection"_u, viewProjection);
+    cullShader->setInt("hiZLevels"_u, occlusion ? hiZLevels : 0);
+
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECTS_BINDING, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counterBuffer);
+    const auto count = static_cast<GLuint>(objects.size());
+    glDispatchCompute((count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    // the commands are read by the indirect draw, the counter by visible_count
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void gpu_scene::draw() const {
+    if (objects.empty())
+        return;
+    gl_state::instance().bind_vertex_array(vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(objects.size()), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+GLuint gpu_scene::visible_count() const {
+    GLuint count = 0;
+    if (counterBuffer == 0)
+        return count;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+    return count;
+}
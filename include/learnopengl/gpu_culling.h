@@ -0,0 +1,95 @@
+//
+// GPU驱动的剔除：所有网格放进共享缓冲区，计算着色器做视锥体和Hi-Z剔除并写入间接绘制命令
+//
+
+#ifndef CG_GPU_CULLING_H
+#define CG_GPU_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/frustum_culling.h>
+#include <learnopengl/occlusion_culling.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// texture unit of the Hi-Z pyramid read by the culling shader, after the material and cluster units
+constexpr GLuint GPU_CULL_HIZ_UNIT = 8;
+
+// Static objects drawn without per-object CPU work. Geometry is appended to one vertex and one index buffer,
+// each object is a geometry plus a model matrix. Every frame a compute shader (gpu_cull.comp) tests the
+// world space bounding spheres against the frustum and against a Hi-Z pyramid built from the CPU occlusion
+// buffer, and writes one DrawElementsIndirectCommand per object with instanceCount 0 or 1. draw() then issues
+// all of them with a single glMultiDrawElementsIndirect. baseInstance is the object index, so the model matrix
+// comes from the instance attributes the INSTANCING shaders already read (INSTANCE_MODEL_ATTRIBUTE).
+// Needs GL 4.3 (compute shaders, SSBOs, multi-draw indirect); check supported() first.
+class gpu_scene {
+public:
+    static bool supported();
+
+    gpu_scene();
+    ~gpu_scene();
+    gpu_scene(const gpu_scene &) = delete;
+    gpu_scene &operator=(const gpu_scene &) = delete;
+
+    // returns the geometry id
+    std::uint32_t add_geometry(const std::vector<vertex> &vertices, const std::vector<std::uint32_t> &indices);
+    // returns the object index
+    std::uint32_t add_object(std::uint32_t geometry, const glm::mat4 &model);
+    // (re)creates the GPU buffers after geometry and objects were added
+    void upload();
+
+    // writes this frame's draw commands; the occlusion buffer must have been rasterized for the same matrix
+    void cull(const glm::mat4 &viewProjection, const occlusion_buffer *occlusion = nullptr);
+    // draws the visible objects with the program in use, which must be an INSTANCING variant
+    void draw() const;
+
+    std::size_t object_count() const { return objects.size(); }
+    // objects that passed the last cull; reads the counter back and so waits for the GPU
+    GLuint visible_count() const;
+
+private:
+    struct geometry {
+        GLuint count;
+        GLuint firstIndex;
+        GLint baseVertex;
+        aabb bounds;
+    };
+    // std430 mirror of Object in gpu_cull.comp
+    struct object_std430 {
+        glm::vec4 sphere;
+        GLuint indexCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint padding;
+    };
+
+    std::unique_ptr<Shader> cullShader;
+    std::vector<vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    std::vector<geometry> geometries;
+    std::vector<object_std430> objects;
+    std::vector<glm::mat4> models;
+
+    GLuint vao = 0;
+    GLuint vertexBuffer = 0, indexBuffer = 0, modelBuffer = 0;
+    GLuint objectBuffer = 0, commandBuffer = 0, counterBuffer = 0;
+
+    // max depth pyramid of the occlusion buffer
+    GLuint hiZ = 0;
+    int hiZLevels = 0;
+    int hiZWidth = 0, hiZHeight = 0;
+    std::vector<std::vector<float>> hiZData;
+
+    void release_buffers();
+    void upload_hi_z(const occlusion_buffer &occlusion);
+};
+
+static_assert(sizeof(glm::vec4) + 4 * sizeof(GLuint) == 32, "Object doesn't match std430");
+
+
+#endif //CG_GPU_CULLING_H
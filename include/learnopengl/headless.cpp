@@ -0,0 +1,106 @@
+//
+// 无窗口渲染：EGL上下文和pbuffer代替GLFW窗口，可以在没有显示器和GPU的机器上用Mesa llvmpipe运行
+//
+
+#include "headless.h"
+#include "utility.h"
+
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+namespace {
+    EGLDisplay open_display() {
+        // a display without a window system needs EGL_MESA_platform_surfaceless; eglGetDisplay may want X11
+        const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY)
+                return display;
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+}
+
+headless_context::headless_context(int width, int height, int major, int minor)
+        : surfaceWidth(width), surfaceHeight(height) {
+    display = open_display();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        throw "Can't open an EGL display.\n";
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        release();
+        throw "EGL doesn't support desktop OpenGL.\n";
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        release();
+        throw "No EGL config for an OpenGL pbuffer.\n";
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        release();
+        throw "Can't create an OpenGL context.\n";
+    }
+
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (surface == EGL_NO_SURFACE) {
+        release();
+        throw "Can't create an EGL pbuffer.\n";
+    }
+
+    make_current();
+    // glad加载所有OpenGL函数指针
+    if (!utility::load_gl([](const char *name) { return reinterpret_cast<void *>(eglGetProcAddress(name)); })) {
+        release();
+        throw "Failed to initialize GLAD";
+    }
+}
+
+headless_context::~headless_context() {
+    release();
+}
+
+void headless_context::release() {
+    if (display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+    surface = EGL_NO_SURFACE;
+}
+
+void headless_context::make_current() const {
+    eglMakeCurrent(display, surface, surface, context);
+}
+
+void headless_context::release_current() const {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void headless_context::swap_buffers() const {
+    eglSwapBuffers(display, surface);
+}
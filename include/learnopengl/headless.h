@@ -0,0 +1,42 @@
+//
+// 无窗口渲染：EGL上下文和pbuffer代替GLFW窗口，可以在没有显示器和GPU的机器上用Mesa llvmpipe运行
+//
+
+#ifndef CG_HEADLESS_H
+#define CG_HEADLESS_H
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+
+// An OpenGL core context on an EGL pbuffer of a fixed size, without a window or a display server. The Mesa
+// surfaceless platform is used when the driver offers it, the default EGL display otherwise. The pbuffer is the
+// context's default framebuffer, so code that renders to framebuffer 0 works unchanged.
+// Like utility::creat_window the constructor throws a const char * if the context can't be created, e.g. when the
+// requested version isn't supported, and loads the GL functions through glad once the context is current.
+class headless_context {
+public:
+    headless_context(int width, int height, int major = 3, int minor = 3);
+    ~headless_context();
+    headless_context(const headless_context &) = delete;
+    headless_context &operator=(const headless_context &) = delete;
+
+    // the context is current on at most one thread at a time
+    void make_current() const;
+    void release_current() const;
+    void swap_buffers() const;
+
+    int width() const { return surfaceWidth; }
+    int height() const { return surfaceHeight; }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    int surfaceWidth;
+    int surfaceHeight;
+
+    void release();
+};
+
+
+#endif //CG_HEADLESS_H
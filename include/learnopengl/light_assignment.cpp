@@ -0,0 +1,115 @@
+//
+// 逐对象光源分配：按衰减半径和包围盒求交，每次绘制只计算影响它的最重要的几个光源
+//
+
+#include "light_assignment.h"
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    float brightest(const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular) {
+        const glm::vec3 channels = glm::max(ambient, glm::max(diffuse, specular));
+        return std::max(channels.r, std::max(channels.g, channels.b));
+    }
+
+    // distance from p to the closest point of the box, 0 inside
+    float distance_to(const aabb &bounds, const glm::vec3 &p) {
+        return glm::length(glm::max(glm::max(bounds.min - p, p - bounds.max), glm::vec3(0.0f)));
+    }
+}
+
+void object_lights::bind(const Shader &shader) const {
+    if (count < 0)
+        return;
+    shader.setIVec4("objectLights"_u, indices);
+    shader.setInt("objectLightCount"_u, count);
+    shader.setBool("objectSpotLight"_u, spot);
+}
+
+light_assignment::light_assignment(int maxLights) :
+    maxLights(std::min(std::max(maxLights, 0), MAX_OBJECT_LIGHTS)) {
+}
+
+void light_assignment::set_lights(const lights_block &lights, int pointLightCount, bool spot) {
+    pointLights.clear();
+    for (int i = 0; i < std::min(pointLightCount, MAX_POINT_LIGHTS); i++) {
+        const point_light_std140 &source = lights.pointLights[i];
+        light l{};
+        l.position = source.position;
+        l.radius = light_clusters::attenuation_radius(source, cutoff);
+        l.intensity = brightest(source.ambient, source.diffuse, source.specular);
+        l.constant = source.constant;
+        l.linear = source.linear;
+        l.quadratic = source.quadratic;
+        pointLights.push_back(l);
+    }
+
+    hasSpot = spot;
+    if (spot) {
+        const spot_light_std140 &source = lights.spotLight;
+        // the falloff of the spotlight is the one of a point light, the cone is tested separately
+        point_light_std140 asPoint{};
+        asPoint.ambient = source.ambient;
+        asPoint.diffuse = source.diffuse;
+        asPoint.specular = source.specular;
+        asPoint.constant = source.constant;
+        asPoint.linear = source.linear;
+        asPoint.quadratic = source.quadratic;
+        spotLight.position = source.position;
+        spotLight.radius = light_clusters::attenuation_radius(asPoint, cutoff);
+        spotDirection = glm::normalize(source.direction);
+        spotCos = source.outerCutOff;
+        spotSin = std::sqrt(std::max(0.0f, 1.0f - spotCos * spotCos));
+        // the ambient term isn't limited to the cone
+        if (brightest(source.ambient, glm::vec3(0.0f), glm::vec3(0.0f)) > 0.0f)
+            spotSin = -1.0f;
+    }
+}
+
+object_lights light_assignment::assign(const aabb &bounds) const {
+    object_lights result;
+    candidates.clear();
+    for (std::size_t i = 0; i < pointLights.size(); i++) {
+        const light &l = pointLights[i];
+        const float distance = distance_to(bounds, l.position);
+        if (distance > l.radius)
+            continue;
+        const float attenuation = 1.0f / (l.constant + l.linear * distance + l.quadratic * distance * distance);
+        candidates.emplace_back(l.intensity * attenuation, static_cast<int>(i));
+    }
+    // keep the brightest maxLights, then order them by index so equal sets compare equal
+    const auto kept = candidates.begin() + std::min<std::ptrdiff_t>(maxLights, candidates.size());
+    std::partial_sort(candidates.begin(), kept, candidates.end(), [](const auto &a, const auto &b) {
+        return a.first > b.first;
+    });
+    std::sort(candidates.begin(), kept, [](const auto &a, const auto &b) { return a.second < b.second; });
+    result.count = static_cast<int>(kept - candidates.begin());
+    for (int i = 0; i < result.count; i++)
+        result.indices[i] = candidates[i].second;
+
+    if (hasSpot && distance_to(bounds, spotLight.position) <= spotLight.radius) {
+        if (spotSin < 0.0f) {
+            result.spot = true;
+        } else {
+            // bounding sphere against the cone: distance of the centre from the cone's surface along the normal
+            const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+            const float radius = glm::length(bounds.max - center);
+            const glm::vec3 v = center - spotLight.position;
+            const float along = glm::dot(v, spotDirection);
+            const float across = std::sqrt(std::max(0.0f, glm::dot(v, v) - along * along));
+            result.spot = spotCos * across - along * spotSin <= radius && along >= -radius;
+        }
+    }
+    return result;
+}
+
+object_lights light_assignment::all() const {
+    object_lights result;
+    result.count = std::min(static_cast<int>(pointLights.size()), maxLights);
+    for (int i = 0; i < result.count; i++)
+        result.indices[i] = i;
+    result.spot = hasSpot;
+    return result;
+}
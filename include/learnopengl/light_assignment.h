@@ -0,0 +1,83 @@
+//
+// 逐对象光源分配：按衰减半径和包围盒求交，每次绘制只计算影响它的最重要的几个光源
+//
+
+#ifndef CG_LIGHT_ASSIGNMENT_H
+#define CG_LIGHT_ASSIGNMENT_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/frustum_culling.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// K, the most point lights one draw evaluates (the objectLights ivec4 of the OBJECT_LIGHTS shaders)
+constexpr int MAX_OBJECT_LIGHTS = 4;
+
+// The lights of the Lights block that reach one object. Draws with equal lists can share an instanced call.
+struct object_lights {
+    // -1 if the draw has no list, the program's uniforms are then left alone
+    int count = -1;
+    // indices into pointLights, the first count are used, in ascending order
+    glm::ivec4 indices{0};
+    // whether the spotlight's cone and range reach the object
+    bool spot = false;
+
+    bool operator==(const object_lights &other) const {
+        return count == other.count && indices == other.indices && spot == other.spot;
+    }
+    bool operator!=(const object_lights &other) const { return !(*this == other); }
+
+    // sets objectLights, objectLightCount and objectSpotLight; the program must be in use
+    void bind(const Shader &shader) const;
+};
+
+// Assigns the point lights and the spotlight of the Lights block to objects on the CPU. Every light stops at the
+// distance where its brightest channel falls below the cutoff (light_clusters::attenuation_radius); a light is
+// relevant for an object when that sphere touches the object's bounds, and for the spotlight the bounding sphere
+// also has to touch its cone. When more than maxLights point lights reach an object, the ones with the highest
+// attenuated intensity at the closest point of the bounds are kept.
+class light_assignment {
+public:
+    explicit light_assignment(int maxLights = MAX_OBJECT_LIGHTS);
+
+    void set_cutoff(float value) { cutoff = value; }
+    float get_cutoff() const { return cutoff; }
+
+    // takes the first pointLightCount point lights and, if spotLight, the spotlight of the block; once per frame
+    // after the lights moved
+    void set_lights(const lights_block &lights, int pointLightCount, bool spotLight);
+
+    object_lights assign(const aabb &bounds) const;
+    // every light set_lights took, for draws whose objects aren't known to the CPU
+    object_lights all() const;
+
+private:
+    struct light {
+        glm::vec3 position;
+        float radius;
+        float intensity;
+        float constant;
+        float linear;
+        float quadratic;
+    };
+
+    int maxLights;
+    float cutoff = 5.0f / 256.0f;
+    std::vector<light> pointLights;
+
+    bool hasSpot = false;
+    light spotLight{};
+    glm::vec3 spotDirection{0.0f, 0.0f, -1.0f};
+    float spotCos = 0.0f;
+    float spotSin = 1.0f;
+
+    // scratch of assign(): candidates sorted by importance
+    mutable std::vector<std::pair<float, int>> candidates;
+};
+
+
+#endif //CG_LIGHT_ASSIGNMENT_H
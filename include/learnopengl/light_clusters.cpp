@@ -0,0 +1,228 @@
+//
+// 分簇光照：把点光源分配到视锥体的三维网格（froxel）中，片段只计算所在簇的光源
+//
+
+#include "light_clusters.h"
+#include "gl_state.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // a padding light: the distance to any cluster overflows its (zero) radius
+    constexpr float NOWHERE = 1e18f;
+
+    // spheres in SoA form, padded to a multiple of 4 for the SSE test
+    struct sphere_set {
+        std::vector<float> x, y, z, r2;
+        std::vector<std::uint32_t> id;
+
+        void clear() {
+            x.clear();
+            y.clear();
+            z.clear();
+            r2.clear();
+            id.clear();
+        }
+        void add(float px, float py, float pz, float radius2, std::uint32_t light) {
+            x.push_back(px);
+            y.push_back(py);
+            z.push_back(pz);
+            r2.push_back(radius2);
+            id.push_back(light);
+        }
+        void pad() {
+            while (x.size() % 4 != 0)
+                add(NOWHERE, NOWHERE, NOWHERE, 0.0f, 0);
+        }
+    };
+
+    struct box {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // calls hit(i) for every sphere i of the set that overlaps the box
+    template<class F>
+    void overlap(const sphere_set &spheres, const box &b, F &&hit) {
+#ifdef CG_SIMD_SSE
+        // squared distance from each centre to the box, four spheres at a time
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps(b.min.x), maxX = _mm_set1_ps(b.max.x);
+        const __m128 minY = _mm_set1_ps(b.min.y), maxY = _mm_set1_ps(b.max.y);
+        const __m128 minZ = _mm_set1_ps(b.min.z), maxZ = _mm_set1_ps(b.max.z);
+        for (std::size_t i = 0; i < spheres.x.size(); i += 4) {
+            const __m128 px = _mm_loadu_ps(&spheres.x[i]);
+            const __m128 py = _mm_loadu_ps(&spheres.y[i]);
+            const __m128 pz = _mm_loadu_ps(&spheres.z[i]);
+            const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, px), _mm_sub_ps(px, maxX)), zero);
+            const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, py), _mm_sub_ps(py, maxY)), zero);
+            const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, pz), _mm_sub_ps(pz, maxZ)), zero);
+            const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            const int hits = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&spheres.r2[i])));
+            for (int lane = 0; lane < 4; lane++) {
+                if (hits & (1 << lane))
+                    hit(i + lane);
+            }
+        }
+#else
+        for (std::size_t i = 0; i < spheres.x.size(); i++) {
+            const float dx = std::max(std::max(b.min.x - spheres.x[i], spheres.x[i] - b.max.x), 0.0f);
+            const float dy = std::max(std::max(b.min.y - spheres.y[i], spheres.y[i] - b.max.y), 0.0f);
+            const float dz = std::max(std::max(b.min.z - spheres.z[i], spheres.z[i] - b.max.z), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= spheres.r2[i])
+                hit(i);
+        }
+#endif
+    }
+
+    void upload(GLuint buffer, const void *data, std::size_t bytes) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // orphan the old storage, a buffer texture may not be empty
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(std::max<std::size_t>(bytes, 16)), nullptr,
+                     GL_STREAM_DRAW);
+        if (bytes > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(bytes), data);
+    }
+}
+
+light_clusters::light_clusters() : grid(CLUSTER_COUNT, glm::uvec2(0)), sliceIndices(CLUSTER_Z) {
+    const GLuint units[3] = {CLUSTER_LIGHTS_UNIT, CLUSTER_GRID_UNIT, CLUSTER_INDICES_UNIT};
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+    for (int i = 0; i < 3; i++) {
+        upload(buffers[i], nullptr, 0);
+        gl_state::instance().bind_texture(units[i], GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+}
+
+light_clusters::~light_clusters() {
+    for (GLuint texture: textures)
+        gl_state::instance().forget_texture(texture);
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+}
+
+float light_clusters::attenuation_radius(const point_light_std140 &light, float cutoff) {
+    const glm::vec3 brightest = glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+    const float intensity = std::max(brightest.r, std::max(brightest.g, brightest.b));
+    // solve quadratic d^2 + linear d + constant = intensity / cutoff
+    const float c = light.constant - intensity / cutoff;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) /
+               (2.0f * light.quadratic);
+    if (light.linear > 0.0f)
+        return -c / light.linear;
+    return std::numeric_limits<float>::max();
+}
+
+void light_clusters::update(const std::vector<point_light_std140> &lights, const glm::mat4 &view,
+                            const glm::mat4 &projection, float near, float far, int width, int height) {
+    // view space SoA copy, the radius travels to the GPU in the padding of the last texel
+    const std::size_t count = lights.size();
+    const std::size_t padded = (count + 3) & ~std::size_t(3);
+    gpuLights = lights;
+    lightX.assign(padded, NOWHERE);
+    lightY.assign(padded, NOWHERE);
+    lightZ.assign(padded, NOWHERE);
+    lightRadius.assign(padded, 0.0f);
+    for (std::size_t i = 0; i < count; i++) {
+        const glm::vec3 position = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+        lightX[i] = position.x;
+        lightY[i] = position.y;
+        lightZ[i] = position.z;
+        lightRadius[i] = attenuation_radius(lights[i], cutoff);
+        gpuLights[i].padding = lightRadius[i];
+    }
+
+    const float xScale = 1.0f / projection[0][0];
+    const float yScale = 1.0f / projection[1][1];
+    thread_pool::shared().parallel_for(0, CLUSTER_Z, [&](std::size_t z) {
+        bin_slice(static_cast<int>(z), near, far, xScale, yScale);
+    });
+
+    // the slices were binned independently, shift their offsets into one list
+    indices.clear();
+    for (int z = 0; z < CLUSTER_Z; z++) {
+        const auto base = static_cast<std::uint32_t>(indices.size());
+        for (int i = z * CLUSTER_X * CLUSTER_Y; i < (z + 1) * CLUSTER_X * CLUSTER_Y; i++)
+            grid[i].x += base;
+        indices.insert(indices.end(), sliceIndices[z].begin(), sliceIndices[z].end());
+    }
+
+    const float logRatio = std::log(far / near);
+    params = glm::vec4(static_cast<float>(CLUSTER_X) / static_cast<float>(std::max(width, 1)),
+                       static_cast<float>(CLUSTER_Y) / static_cast<float>(std::max(height, 1)),
+                       static_cast<float>(CLUSTER_Z) / logRatio,
+                       -static_cast<float>(CLUSTER_Z) * std::log(near) / logRatio);
+
+    upload(buffers[0], gpuLights.data(), gpuLights.size() * sizeof(point_light_std140));
+    upload(buffers[1], grid.data(), grid.size() * sizeof(glm::uvec2));
+    upload(buffers[2], indices.data(), indices.size() * sizeof(std::uint32_t));
+}
+
+void light_clusters::bin_slice(int z, float near, float far, float xScale, float yScale) {
+    const float ratio = far / near;
+    const float sliceNear = near * std::pow(ratio, static_cast<float>(z) / CLUSTER_Z);
+    const float sliceFar = near * std::pow(ratio, static_cast<float>(z + 1) / CLUSTER_Z);
+
+    // lights reaching the depth range of the slice (the camera looks down -z)
+    sphere_set slice;
+    for (std::size_t i = 0; i < lightRadius.size(); i++) {
+        const float depth = -lightZ[i];
+        if (depth + lightRadius[i] >= sliceNear && depth - lightRadius[i] <= sliceFar)
+            slice.add(lightX[i], lightY[i], lightZ[i], lightRadius[i] * lightRadius[i], static_cast<std::uint32_t>(i));
+    }
+    slice.pad();
+
+    // view space bounds of the froxel edges: x at ndc n and depth d is n * d / projection[0][0]
+    auto extent = [&](float ndc0, float ndc1, float scale) {
+        return glm::vec2(std::min(ndc0 * sliceNear, ndc0 * sliceFar) * scale,
+                         std::max(ndc1 * sliceNear, ndc1 * sliceFar) * scale);
+    };
+    const glm::vec2 rowX = extent(-1.0f, 1.0f, xScale);
+
+    std::vector<std::uint32_t> &out = sliceIndices[z];
+    out.clear();
+    sphere_set row;
+    for (int y = 0; y < CLUSTER_Y; y++) {
+        const glm::vec2 rangeY = extent(-1.0f + 2.0f * static_cast<float>(y) / CLUSTER_Y,
+                                        -1.0f + 2.0f * static_cast<float>(y + 1) / CLUSTER_Y, yScale);
+        // the lights of the whole row first, so each froxel only tests lights that are close
+        row.clear();
+        overlap(slice, box{{rowX.x, rangeY.x, -sliceFar}, {rowX.y, rangeY.y, -sliceNear}}, [&](std::size_t i) {
+            row.add(slice.x[i], slice.y[i], slice.z[i], slice.r2[i], slice.id[i]);
+        });
+        row.pad();
+        for (int x = 0; x < CLUSTER_X; x++) {
+            const glm::vec2 rangeX = extent(-1.0f + 2.0f * static_cast<float>(x) / CLUSTER_X,
+                                            -1.0f + 2.0f * static_cast<float>(x + 1) / CLUSTER_X, xScale);
+            const auto first = static_cast<std::uint32_t>(out.size());
+            overlap(row, box{{rangeX.x, rangeY.x, -sliceFar}, {rangeX.y, rangeY.y, -sliceNear}},
+                    [&](std::size_t i) { out.push_back(row.id[i]); });
+            grid[x + CLUSTER_X * (y + CLUSTER_Y * z)] =
+                glm::uvec2(first, static_cast<std::uint32_t>(out.size()) - first);
+        }
+    }
+}
+
+void light_clusters::bind(const Shader &shader) const {
+    auto &state = gl_state::instance();
+    state.bind_texture(CLUSTER_LIGHTS_UNIT, GL_TEXTURE_BUFFER, textures[0]);
+    state.bind_texture(CLUSTER_GRID_UNIT, GL_TEXTURE_BUFFER, textures[1]);
+    state.bind_texture(CLUSTER_INDICES_UNIT, GL_TEXTURE_BUFFER, textures[2]);
+    shader.setVec4("clusterParams"_u, params);
+}
+
+void light_clusters::bind_samplers(const Shader &shader) {
+    shader.setInt("clusterLights"_u, static_cast<int>(CLUSTER_LIGHTS_UNIT));
+    shader.setInt("clusterGrid"_u, static_cast<int>(CLUSTER_GRID_UNIT));
+    shader.setInt("clusterIndices"_u, static_cast<int>(CLUSTER_INDICES_UNIT));
+}
@@ -0,0 +1,80 @@
+//
+// 分簇光照：把点光源分配到视锥体的三维网格（froxel）中，片段只计算所在簇的光源
+//
+
+#ifndef CG_LIGHT_CLUSTERS_H
+#define CG_LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/uniform_blocks.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// grid size (CLUSTER_X/Y/Z in clusters.glsl): screen tiles in x and y, exponential depth slices in z
+constexpr int CLUSTER_X = 16;
+constexpr int CLUSTER_Y = 9;
+constexpr int CLUSTER_Z = 24;
+constexpr int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// texture units of the three buffer textures; units 0-2 belong to the material
+constexpr GLuint CLUSTER_LIGHTS_UNIT = 3;
+constexpr GLuint CLUSTER_GRID_UNIT = 4;
+constexpr GLuint CLUSTER_INDICES_UNIT = 5;
+
+// Clustered forward lighting. Every frame the lights are bound to the froxels of the camera frustum they can
+// reach: the lights are transformed to view space as SoA arrays, each depth slice keeps the lights overlapping
+// it, and the slices are binned in parallel on the shared thread pool, four lights per SSE sphere/box test.
+// The result goes to the GPU in three buffer textures (the context is 3.3, so no SSBOs):
+//   lights   RGBA32F, 4 texels per light in the point_light_std140 layout, w of the last one is the radius
+//   grid     RG32UI, (first index, count) per cluster
+//   indices  R32UI, light numbers of all clusters back to back
+class light_clusters {
+public:
+    light_clusters();
+    ~light_clusters();
+    light_clusters(const light_clusters &) = delete;
+    light_clusters &operator=(const light_clusters &) = delete;
+
+    // a light stops at the distance where its brightest channel falls below cutoff
+    void set_cutoff(float value) { cutoff = value; }
+    float get_cutoff() const { return cutoff; }
+
+    // bins the lights for a symmetric perspective projection (glm::perspective) and uploads the result
+    void update(const std::vector<point_light_std140> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                float near, float far, int width, int height);
+    // binds the buffer textures and sets the per-frame uniforms; the program must be in use
+    void bind(const Shader &shader) const;
+    // points the samplers of a program at the cluster units, once per program
+    static void bind_samplers(const Shader &shader);
+
+    // distance at which the attenuation 1 / (constant + linear d + quadratic d^2) times the brightest channel
+    // reaches cutoff
+    static float attenuation_radius(const point_light_std140 &light, float cutoff);
+
+    std::size_t light_count() const { return gpuLights.size(); }
+    std::size_t index_count() const { return indices.size(); }
+
+private:
+    float cutoff = 5.0f / 256.0f;
+    // x, y: clusters per pixel, z, w: slice = log(depth) * z + w
+    glm::vec4 params{0.0f};
+
+    GLuint buffers[3]{};
+    GLuint textures[3]{};
+
+    std::vector<point_light_std140> gpuLights;
+    // view space lights, padded to a multiple of 4 with lights that reach nothing
+    std::vector<float> lightX, lightY, lightZ, lightRadius;
+    std::vector<glm::uvec2> grid;
+    std::vector<std::uint32_t> indices;
+    std::vector<std::vector<std::uint32_t>> sliceIndices;
+
+    void bin_slice(int slice, float near, float far, float xScale, float yScale);
+};
+
+
+#endif //CG_LIGHT_CLUSTERS_H
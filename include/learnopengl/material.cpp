@@ -0,0 +1,61 @@
+//
+// 材质：加载时确定每种贴图的纹理单元，绑定时只做整数操作
+//
+
+#include "material.h"
+#include "gl_state.h"
+#include "texture_residency.h"
+
+#include <cstring>
+
+material::material(const std::array<GLuint, TEXTURE_ROLE_COUNT> &textures, bool packed_specular, float shininess) :
+    textures(textures), packed(packed_specular), shine(shininess) {
+    // 64 bit FNV-1a over everything bind() sets
+    hash = 14695981039346656037ull;
+    auto mix = [this](std::uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    for (std::size_t role = 0; role < TEXTURE_ROLE_COUNT; role++) {
+        mix(textures[role]);
+        if (textures[role] != 0)
+            bindings[bindingCount++] = {TEXTURE_ROLE_UNITS[role], textures[role]};
+    }
+    std::uint32_t shininessBits;
+    std::memcpy(&shininessBits, &shine, sizeof(shininessBits));
+    mix(shininessBits);
+    mix(packed ? 1u : 0u);
+}
+
+shader_features material::features() const {
+    shader_features features;
+    features.specular_map = has(texture_role::specular) || packed;
+    features.packed_specular = packed;
+    features.normal_map = has(texture_role::normal);
+    return features;
+}
+
+void material::bind(const Shader &shader) const {
+    auto &state = gl_state::instance();
+    auto &residency = texture_residency::instance();
+    for (std::size_t i = 0; i < bindingCount; i++) {
+        state.bind_texture(bindings[i].first, GL_TEXTURE_2D, bindings[i].second);
+        residency.touch(bindings[i].second);
+    }
+    shader.setFloat("material.shininess"_u, shine);
+}
+
+void material::bind_samplers(const Shader &shader) {
+    const std::pair<uniform_name, texture_role> samplers[] = {
+            {"material.diffuse"_u,   texture_role::diffuse},
+            {"material.specular"_u,  texture_role::specular},
+            {"material.normal"_u,    texture_role::normal},
+            {"texture_diffuse1"_u,   texture_role::diffuse},
+            {"texture_specular1"_u,  texture_role::specular},
+            {"texture_normal1"_u,    texture_role::normal},
+            {"texture_height1"_u,    texture_role::height},
+            {"texture_roughness1"_u, texture_role::roughness},
+    };
+    for (const auto &sampler: samplers)
+        shader.setInt(sampler.first, static_cast<int>(texture_unit(sampler.second)));
+}
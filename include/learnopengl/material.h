@@ -0,0 +1,72 @@
+//
+// 材质：加载时确定每种贴图的纹理单元，绑定时只做整数操作
+//
+
+#ifndef CG_MATERIAL_H
+#define CG_MATERIAL_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/shader_variants.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+enum class texture_role : std::uint8_t {
+    diffuse,
+    specular,
+    normal,
+    height,
+    roughness,
+    count
+};
+
+constexpr std::size_t TEXTURE_ROLE_COUNT = static_cast<std::size_t>(texture_role::count);
+
+// texture unit of each role, the same in every program; units 3-5 belong to the light clusters
+constexpr GLuint TEXTURE_ROLE_UNITS[TEXTURE_ROLE_COUNT] = {0, 1, 2, 6, 7};
+
+constexpr GLuint texture_unit(texture_role role) {
+    return TEXTURE_ROLE_UNITS[static_cast<std::size_t>(role)];
+}
+
+// An immutable set of maps plus the scalar parameters, resolved when it is loaded. Samplers never change
+// units, so a program points them at TEXTURE_ROLE_UNITS once (bind_samplers) and binding a material is a loop of
+// integer texture binds.
+class material {
+public:
+    material() = default;
+    // one texture per role, 0 where the material has no such map; packed_specular means the specular mask is
+    // in the alpha channel of the diffuse map
+    explicit material(const std::array<GLuint, TEXTURE_ROLE_COUNT> &textures, bool packed_specular = false,
+                      float shininess = 32.0f);
+
+    GLuint texture(texture_role role) const { return textures[static_cast<std::size_t>(role)]; }
+    bool has(texture_role role) const { return texture(role) != 0; }
+    bool packed_specular() const { return packed; }
+    float shininess() const { return shine; }
+    // equal for materials that bind the same state, for sorting draws
+    std::uint64_t state_hash() const { return hash; }
+    // the shader variant features the maps need; the lights are up to the caller
+    shader_features features() const;
+
+    // binds the maps to their units and sets the per-material uniforms of the program in use
+    void bind(const Shader &shader) const;
+    // points every sampler a program may declare (material.diffuse, texture_diffuse1, ...) at its unit;
+    // once per program, which must be in use
+    static void bind_samplers(const Shader &shader);
+
+private:
+    std::array<GLuint, TEXTURE_ROLE_COUNT> textures{};
+    // (unit, texture) of the maps the material has
+    std::array<std::pair<GLuint, GLuint>, TEXTURE_ROLE_COUNT> bindings{};
+    std::size_t bindingCount = 0;
+    bool packed = false;
+    float shine = 32.0f;
+    std::uint64_t hash = 0;
+};
+
+
+#endif //CG_MATERIAL_H
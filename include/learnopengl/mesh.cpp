@@ -3,9 +3,17 @@
 //
 
 #include "mesh.h"
+#include "gl_state.h"
 
-mesh::mesh(std::vector<vertex> vertices, std::vector<unsigned int> indices, std::vector<texture> textures) :
-    vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)) {
+mesh::mesh(std::vector<vertex> vertices, std::vector<unsigned int> indices, material mat) :
+    vertices(std::move(vertices)), indices(std::move(indices)), mat(mat) {
+    if (!this->vertices.empty()) {
+        bounds = aabb{this->vertices[0].position, this->vertices[0].position};
+        for (const auto &v: this->vertices) {
+            bounds.min = glm::min(bounds.min, v.position);
+            bounds.max = glm::max(bounds.max, v.position);
+        }
+    }
     set_up_mesh();
 }
 
@@ -15,7 +23,7 @@ void mesh::set_up_mesh() {
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ebo);
 
-    glBindVertexArray(vao);
+    gl_state::instance().bind_vertex_array(vao);
     // load data into vertex buffers
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     // A great thing about structs is that their memory layout is sequential for all its items.
@@ -49,43 +57,25 @@ void mesh::set_up_mesh() {
     // weights
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)offsetof(vertex, m_weights));
-    glBindVertexArray(0);
 }
 
 
 void mesh::draw(const Shader &shader) const {
-    // bind appropriate textures
-    unsigned int diffuseNr  = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr   = 1;
-    unsigned int heightNr   = 1;
-    for(unsigned int i = 0; i < textures.size(); i++)
-    {
-        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        std::string number;
-        std::string name = textures[i].type;
-        if(name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if(name == "texture_specular")
-            number = std::to_string(specularNr++); // transfer unsigned int to string
-        else if(name == "texture_normal")
-            number = std::to_string(normalNr++); // transfer unsigned int to string
-        else if(name == "texture_height")
-            number = std::to_string(heightNr++); // transfer unsigned int to string
-
-        // now set the sampler to the correct texture unit
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
-    }
+    // bind appropriate textures; units that already hold them are skipped by the state tracker
+    mat.bind(shader);
 
     // draw mesh
-    glBindVertexArray(vao);
+    gl_state::instance().bind_vertex_array(vao);
     glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+}
 
+void mesh::submit(render_queue &queue, render_pass pass, const Shader &shader, const glm::mat4 &model) const {
+    draw_command command;
+    command.shader = &shader;
+    command.vao = vao;
+    command.indexed = true;
+    command.count = static_cast<GLsizei>(indices.size());
+    command.mat = &mat;
+    command.model = model;
+    queue.submit(pass, command);
 }
@@ -9,8 +9,10 @@
 #include <string>
 #include <vector>
 #include <glm/gtc/matrix_transform.hpp>
-#include <learnopengl/shader_s.h>
 #include <learnopengl/shader_m.h>
+#include <learnopengl/material.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/frustum_culling.h>
 
 constexpr unsigned int MAX_BONE_INFLUENCE = 4;
 struct vertex {
@@ -25,7 +27,7 @@ struct vertex {
 
 struct texture {
     unsigned int id;
-    std::string type;
+    texture_role role;
     std::string path;
 };
 
@@ -33,14 +35,21 @@ class mesh {
 private:
     std::vector<vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<texture> textures;
+    material mat;
+    aabb bounds{};
     unsigned int vao{};
     unsigned int vbo{};
     unsigned int ebo{};
     void set_up_mesh();
 public:
-    explicit mesh(std::vector<vertex> vertices, std::vector<unsigned int> indices, std::vector<texture> textures);
+    explicit mesh(std::vector<vertex> vertices, std::vector<unsigned int> indices, material mat);
+    // the samplers of the program must have been set with material::bind_samplers
     void draw(const Shader& shader) const;
+    // queues the mesh instead of drawing it now
+    void submit(render_queue& queue, render_pass pass, const Shader& shader, const glm::mat4& model) const;
+    const material& get_material() const { return mat; }
+    // object space bounds of the vertices
+    const aabb& get_bounds() const { return bounds; }
 };
 
 
@@ -0,0 +1,370 @@
+//
+// CPU端的mipmap链生成，sRGB纹理在线性空间中滤波
+//
+
+#include "mipmap.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "gl_state.h"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+    // rows handed to one worker at a time
+    constexpr int rows_per_job = 16;
+
+    // working copy of a level: 4 floats per pixel, colour in linear space
+    struct float_image {
+        int width = 0;
+        int height = 0;
+        std::vector<float> rgba;
+
+        float *pixel(int x, int y) { return &rgba[(static_cast<std::size_t>(y) * width + x) * 4]; }
+        const float *pixel(int x, int y) const { return &rgba[(static_cast<std::size_t>(y) * width + x) * 4]; }
+    };
+
+    const std::array<float, 256> &srgb_to_linear_table() {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> t{};
+            for (int i = 0; i < 256; i++) {
+                const float c = static_cast<float>(i) / 255.0f;
+                t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    float linear_to_srgb(float c) {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // modified Bessel function of the first kind, order 0
+    double bessel_i0(double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // weights of the 2:1 Kaiser windowed sinc. Output texel i is centred between source texels 2i and 2i+1,
+    // tap t reads source texel 2i - 3 + t.
+    constexpr int kaiser_taps = 8;
+
+    const std::array<float, kaiser_taps> &kaiser_weights() {
+        static const std::array<float, kaiser_taps> weights = [] {
+            constexpr double pi = 3.14159265358979323846;
+            constexpr double alpha = 4.0;
+            constexpr double radius = kaiser_taps / 2.0;
+            std::array<double, kaiser_taps> w{};
+            double total = 0.0;
+            for (int t = 0; t < kaiser_taps; t++) {
+                const double x = t - radius + 0.5; // distance in source texels
+                const double s = x * 0.5;          // cut off at half the source frequency
+                const double sinc = std::abs(s) < 1e-9 ? 1.0 : std::sin(pi * s) / (pi * s);
+                const double r = x / radius;
+                const double window = bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(alpha);
+                w[t] = sinc * window;
+                total += w[t];
+            }
+            std::array<float, kaiser_taps> normalised{};
+            for (int t = 0; t < kaiser_taps; t++) {
+                normalised[t] = static_cast<float>(w[t] / total);
+            }
+            return normalised;
+        }();
+        return weights;
+    }
+
+    // runs fn(first_row, last_row) over [0, rows) in chunks on the shared pool
+    template<class F>
+    void for_each_row_block(int rows, F &&fn) {
+        const int blocks = (rows + rows_per_job - 1) / rows_per_job;
+        thread_pool::shared().parallel_for(0, static_cast<std::size_t>(blocks), [&](std::size_t block) {
+            const int first = static_cast<int>(block) * rows_per_job;
+            fn(first, std::min(rows, first + rows_per_job));
+        });
+    }
+
+    float_image expand(const unsigned char *pixels, int width, int height, int channels, bool srgb) {
+        const auto &to_linear = srgb_to_linear_table();
+        float_image image;
+        image.width = width;
+        image.height = height;
+        image.rgba.assign(static_cast<std::size_t>(width) * height * 4, 0.0f);
+        for_each_row_block(height, [&](int first, int last) {
+            for (int y = first; y < last; y++) {
+                for (int x = 0; x < width; x++) {
+                    const unsigned char *in = pixels + (static_cast<std::size_t>(y) * width + x) * channels;
+                    float *out = image.pixel(x, y);
+                    for (int c = 0; c < channels; c++) {
+                        const bool colour = srgb && c < 3;
+                        out[c] = colour ? to_linear[in[c]] : static_cast<float>(in[c]) / 255.0f;
+                    }
+                }
+            }
+        });
+        return image;
+    }
+
+    mip_level pack(const float_image &image, int channels, bool srgb) {
+        mip_level level{image.width, image.height, {}};
+        level.pixels.resize(static_cast<std::size_t>(image.width) * image.height * channels);
+        for_each_row_block(image.height, [&](int first, int last) {
+            for (int y = first; y < last; y++) {
+                for (int x = 0; x < image.width; x++) {
+                    const float *in = image.pixel(x, y);
+                    unsigned char *out = &level.pixels[(static_cast<std::size_t>(y) * image.width + x) * channels];
+                    for (int c = 0; c < channels; c++) {
+                        float v = std::min(1.0f, std::max(0.0f, in[c]));
+                        if (srgb && c < 3)
+                            v = linear_to_srgb(v);
+                        out[c] = static_cast<unsigned char>(v * 255.0f + 0.5f);
+                    }
+                }
+            }
+        });
+        return level;
+    }
+
+    float_image downsample_box(const float_image &src) {
+        float_image dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.rgba.resize(static_cast<std::size_t>(dst.width) * dst.height * 4);
+        for_each_row_block(dst.height, [&](int first, int last) {
+            for (int y = first; y < last; y++) {
+                const int y0 = std::min(2 * y, src.height - 1);
+                const int y1 = std::min(2 * y + 1, src.height - 1);
+                for (int x = 0; x < dst.width; x++) {
+                    const int x0 = std::min(2 * x, src.width - 1);
+                    const int x1 = std::min(2 * x + 1, src.width - 1);
+#ifdef CG_SIMD_SSE
+                    __m128 sum = _mm_add_ps(_mm_loadu_ps(src.pixel(x0, y0)), _mm_loadu_ps(src.pixel(x1, y0)));
+                    sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(src.pixel(x0, y1)), _mm_loadu_ps(src.pixel(x1, y1))));
+                    _mm_storeu_ps(dst.pixel(x, y), _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                    float *out = dst.pixel(x, y);
+                    for (int c = 0; c < 4; c++) {
+                        out[c] = (src.pixel(x0, y0)[c] + src.pixel(x1, y0)[c] +
+                                  src.pixel(x0, y1)[c] + src.pixel(x1, y1)[c]) * 0.25f;
+                    }
+#endif
+                }
+            }
+        });
+        return dst;
+    }
+
+    // accumulates weights[t] * taps[t] for all kaiser taps
+    inline void kaiser_sum(const std::array<float, kaiser_taps> &weights, const float *const taps[kaiser_taps],
+                           float *out) {
+#ifdef CG_SIMD_SSE
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0; t < kaiser_taps; t++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(taps[t])));
+        }
+        _mm_storeu_ps(out, acc);
+#else
+        for (int c = 0; c < 4; c++) {
+            float acc = 0.0f;
+            for (int t = 0; t < kaiser_taps; t++) {
+                acc += weights[t] * taps[t][c];
+            }
+            out[c] = acc;
+        }
+#endif
+    }
+
+    float_image downsample_kaiser(const float_image &src) {
+        const auto &weights = kaiser_weights();
+        const int half = kaiser_taps / 2;
+
+        // horizontal pass: src.width -> dst width, all source rows
+        float_image horizontal;
+        horizontal.width = std::max(1, src.width / 2);
+        horizontal.height = src.height;
+        horizontal.rgba.resize(static_cast<std::size_t>(horizontal.width) * horizontal.height * 4);
+        for_each_row_block(horizontal.height, [&](int first, int last) {
+            const float *taps[kaiser_taps];
+            for (int y = first; y < last; y++) {
+                for (int x = 0; x < horizontal.width; x++) {
+                    for (int t = 0; t < kaiser_taps; t++) {
+                        const int sx = std::min(std::max(2 * x - half + 1 + t, 0), src.width - 1);
+                        taps[t] = src.pixel(sx, y);
+                    }
+                    kaiser_sum(weights, taps, horizontal.pixel(x, y));
+                }
+            }
+        });
+
+        // vertical pass
+        float_image dst;
+        dst.width = horizontal.width;
+        dst.height = std::max(1, src.height / 2);
+        dst.rgba.resize(static_cast<std::size_t>(dst.width) * dst.height * 4);
+        for_each_row_block(dst.height, [&](int first, int last) {
+            const float *taps[kaiser_taps];
+            for (int y = first; y < last; y++) {
+                for (int x = 0; x < dst.width; x++) {
+                    for (int t = 0; t < kaiser_taps; t++) {
+                        const int sy = std::min(std::max(2 * y - half + 1 + t, 0), horizontal.height - 1);
+                        taps[t] = horizontal.pixel(x, sy);
+                    }
+                    kaiser_sum(weights, taps, dst.pixel(x, y));
+                }
+            }
+        });
+        return dst;
+    }
+}
+
+std::size_t mip_chain::byte_size() const {
+    std::size_t bytes = 0;
+    for (const auto &level: levels) {
+        bytes += level.pixels.size();
+    }
+    return bytes;
+}
+
+mip_chain generate_mip_chain(const unsigned char *pixels, int width, int height, int channels, bool srgb,
+                             mip_filter filter) {
+    mip_chain chain;
+    chain.channels = channels;
+    // there are no one or two channel sRGB formats, those images are treated as linear data
+    chain.srgb = srgb && channels >= 3;
+    chain.source.srgb = chain.srgb;
+    chain.source.filter = filter;
+
+    mip_level base{width, height, {}};
+    base.pixels.assign(pixels, pixels + static_cast<std::size_t>(width) * height * channels);
+    chain.levels.push_back(std::move(base));
+
+    // every level is filtered from the float copy of the previous one so rounding errors don't add up
+    float_image current = expand(pixels, width, height, channels, chain.srgb);
+    while (current.width > 1 || current.height > 1) {
+        current = filter == mip_filter::box ? downsample_box(current) : downsample_kaiser(current);
+        chain.levels.push_back(pack(current, channels, chain.srgb));
+    }
+    return chain;
+}
+
+std::string mip_source::key() const {
+    return filename + '|' + alpha_filename + '|' + std::to_string(channels) + (srgb ? "|srgb" : "|linear");
+}
+
+mip_chain load_mip_chain(const mip_source &source) {
+    int width, height, nrComponents;
+    if (source.alpha_filename.empty()) {
+        unsigned char *data = stbi_load(source.filename.c_str(), &width, &height, &nrComponents, source.channels);
+        if (!data) {
+            throw std::string("Texture failed to load at path: ") + source.filename;
+        }
+        const int channels = source.channels != 0 ? source.channels : nrComponents;
+        mip_chain chain = generate_mip_chain(data, width, height, channels, source.srgb, source.filter);
+        chain.source = source;
+        stbi_image_free(data);
+        return chain;
+    }
+
+    // colour in rgb, the single channel image in alpha
+    unsigned char *colour = stbi_load(source.filename.c_str(), &width, &height, &nrComponents, 3);
+    if (!colour) {
+        throw std::string("Texture failed to load at path: ") + source.filename;
+    }
+    int alpha_width, alpha_height;
+    unsigned char *alpha = stbi_load(source.alpha_filename.c_str(), &alpha_width, &alpha_height, &nrComponents, 1);
+    if (!alpha || alpha_width != width || alpha_height != height) {
+        stbi_image_free(colour);
+        stbi_image_free(alpha);
+        throw std::string("Texture can't be packed into the alpha channel: ") + source.alpha_filename;
+    }
+    const std::size_t count = static_cast<std::size_t>(width) * height;
+    std::vector<unsigned char> packed(count * 4);
+    for (std::size_t i = 0; i < count; i++) {
+        packed[i * 4 + 0] = colour[i * 3 + 0];
+        packed[i * 4 + 1] = colour[i * 3 + 1];
+        packed[i * 4 + 2] = colour[i * 3 + 2];
+        packed[i * 4 + 3] = alpha[i];
+    }
+    stbi_image_free(colour);
+    stbi_image_free(alpha);
+    mip_chain chain = generate_mip_chain(packed.data(), width, height, 4, source.srgb, source.filter);
+    chain.source = source;
+    return chain;
+}
+
+mip_chain load_mip_chain(const std::string &filename, bool srgb, mip_filter filter) {
+    mip_source source;
+    source.filename = filename;
+    source.srgb = srgb;
+    source.filter = filter;
+    return load_mip_chain(source);
+}
+
+std::future<mip_chain> load_mip_chain_async(const mip_source &source) {
+    return thread_pool::shared().submit([source] {
+        return load_mip_chain(source);
+    });
+}
+
+std::future<mip_chain> load_mip_chain_async(const std::string &filename, bool srgb, mip_filter filter) {
+    mip_source source;
+    source.filename = filename;
+    source.srgb = srgb;
+    source.filter = filter;
+    return load_mip_chain_async(source);
+}
+
+void upload_mip_chain(unsigned int texture_id, const mip_chain &chain) {
+    GLenum format, internal_format;
+    switch (chain.channels) {
+        case 1:
+            format = GL_RED;
+            internal_format = GL_R8;
+            break;
+        case 2:
+            format = GL_RG;
+            internal_format = GL_RG8;
+            break;
+        case 3:
+            format = GL_RGB;
+            internal_format = chain.srgb ? GL_SRGB8 : GL_RGB8;
+            break;
+        default:
+            format = GL_RGBA;
+            internal_format = chain.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            break;
+    }
+
+    gl_state::instance().bind_texture(0, GL_TEXTURE_2D, texture_id);
+    // rows of the smaller levels are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (std::size_t i = 0; i < chain.levels.size(); i++) {
+        const auto &level = chain.levels[i];
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), static_cast<GLint>(internal_format), level.width,
+                     level.height, 0, format, GL_UNSIGNED_BYTE, level.pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(chain.levels.size()) - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+unsigned int upload_mip_chain(const mip_chain &chain) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    upload_mip_chain(textureID, chain);
+    return textureID;
+}
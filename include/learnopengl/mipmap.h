@@ -0,0 +1,68 @@
+//
+// CPU端的mipmap链生成，sRGB纹理在线性空间中滤波
+//
+
+#ifndef CG_MIPMAP_H
+#define CG_MIPMAP_H
+
+#include <cstddef>
+#include <future>
+#include <string>
+#include <vector>
+
+enum class mip_filter {
+    box,    // 2x2 average, cheapest
+    kaiser  // 8-tap Kaiser windowed sinc, keeps detail without ringing
+};
+
+struct mip_level {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+// everything needed to build a chain from files, so it can be built again later
+struct mip_source {
+    std::string filename;
+    // optional single channel image (e.g. a specular mask) stored in the alpha channel of filename's colour
+    std::string alpha_filename;
+    // channels to keep: 0 keeps the file's own count, 1 stores a single channel mask (GL_R8)
+    int channels = 0;
+    bool srgb = false;
+    mip_filter filter = mip_filter::kaiser;
+
+    // identifies the resulting texture, used to share textures between meshes
+    std::string key() const;
+};
+
+struct mip_chain {
+    int channels = 0;
+    bool srgb = false;
+    // empty filename for chains generated from memory
+    mip_source source;
+    std::vector<mip_level> levels;
+    std::size_t byte_size() const;
+};
+
+// builds every level down to 1x1 from tightly packed 8 bit pixels. For sRGB images the colour channels are
+// decoded to linear before filtering and encoded again afterwards; alpha is always filtered as is.
+// The result only depends on the input, so it can be compared byte for byte without a GL context.
+mip_chain generate_mip_chain(const unsigned char *pixels, int width, int height, int channels, bool srgb,
+                             mip_filter filter = mip_filter::kaiser);
+
+// decodes the image file(s) and builds the chain. Throws a std::string if a file can't be loaded or the
+// alpha image doesn't match the colour image in size.
+mip_chain load_mip_chain(const mip_source &source);
+mip_chain load_mip_chain(const std::string &filename, bool srgb, mip_filter filter = mip_filter::kaiser);
+
+// same as load_mip_chain but runs on the shared worker pool, so several textures are decoded and filtered at once
+std::future<mip_chain> load_mip_chain_async(const mip_source &source);
+std::future<mip_chain> load_mip_chain_async(const std::string &filename, bool srgb,
+                                            mip_filter filter = mip_filter::kaiser);
+
+// uploads all levels of the chain into a texture object (needs a current GL context)
+void upload_mip_chain(unsigned int texture_id, const mip_chain &chain);
+unsigned int upload_mip_chain(const mip_chain &chain);
+
+
+#endif //CG_MIPMAP_H
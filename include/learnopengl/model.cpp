@@ -10,10 +10,37 @@ void model::draw(const Shader &shader) const {
     });
 }
 
-model::model(const std::string &path, bool gamma) : gamma_correction(gamma) {
+void model::submit(render_queue &queue, render_pass pass, const Shader &shader, const glm::mat4 &model) const {
+    std::for_each(meshes.cbegin(), meshes.cend(), [&](const mesh &mesh) {
+        mesh.submit(queue, pass, shader, model);
+    });
+}
+
+std::size_t model::submit(render_queue &queue, render_pass pass, const Shader &shader, const glm::mat4 &model,
+                          const frustum &view, const occlusion_buffer *occlusion) const {
+    mesh_bounds.clear();
+    for (const auto &mesh: meshes)
+        mesh_bounds.add(mesh.get_bounds().transformed(model));
+    visible_meshes.clear();
+    cull_aabbs(view, mesh_bounds, visible_meshes);
+    if (occlusion)
+        occlusion->filter(mesh_bounds, visible_meshes);
+    for (auto index: visible_meshes)
+        meshes[index].submit(queue, pass, shader, model);
+    return visible_meshes.size();
+}
+
+model::model(const std::string &path, bool gamma, texture_import_options options) :
+    gamma_correction(gamma), import_options(options) {
     load_model(path);
 }
 
+model::~model() {
+    for (const auto &texture: textures_loaded) {
+        texture_residency::instance().release(texture.id);
+    }
+}
+
 void model::load_model(const std::string &path) {
     // read file via ASSIMP
     Assimp::Importer importer;
@@ -28,8 +55,24 @@ void model::load_model(const std::string &path) {
     // retrieve the directory path of the filepath
     directory = path.substr(0, path.find_last_of('/'));
 
+    // decode every texture of the scene and build its mip chain in parallel, so that
+    // processing the nodes only has to wait for the uploads
+    prefetch_textures(scene);
+
     // process ASSIMP's root node recursively
     process_node(scene->mRootNode, scene);
+    pending_textures.clear();
+}
+
+void model::prefetch_textures(const aiScene *scene) {
+    for (unsigned int m = 0; m < scene->mNumMaterials; m++) {
+        for (const auto &item: material_sources(scene->mMaterials[m])) {
+            const std::string key = item.second.key();
+            if (pending_textures.count(key) == 0) {
+                pending_textures.emplace(key, load_mip_chain_async(item.second));
+            }
+        }
+    }
 }
 
 void model::process_node(aiNode *node, const aiScene *scene) {
@@ -51,7 +94,6 @@ mesh model::process_mesh(aiMesh *aiMesh, const aiScene *scene) {
     // data to fill
     vector<vertex> vertices;
     vector<unsigned int> indices;
-    vector<texture> textures;
 
     // walk through each of the aiMesh's vertices
     for (unsigned int i = 0; i < aiMesh->mNumVertices; i++) {
@@ -101,90 +143,99 @@ mesh model::process_mesh(aiMesh *aiMesh, const aiScene *scene) {
             indices.push_back(face.mIndices[j]);
     }
     // process materials
-    aiMaterial *material = scene->mMaterials[aiMesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-    // Same applies to other texture as the following list summarizes:
-    // diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
-
-    // 1. diffuse maps
-    vector<texture> diffuseMaps = load_material_textures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    // 2. specular maps
-    vector<texture> specularMaps = load_material_textures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-    // 3. normal maps
-    std::vector<texture> normalMaps = load_material_textures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-    // 4. height maps
-    std::vector<texture> heightMaps = load_material_textures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+    // every map has a fixed texture unit (TEXTURE_ROLE_UNITS) that the samplers of the shaders are set to once:
+    // diffuse: material.diffuse or texture_diffuse1
+    // specular: material.specular or texture_specular1
+    // normal: material.normal or texture_normal1
+    // height: texture_height1
+    // roughness: texture_roughness1
+    // with import_options.pack_specular the first specular map lives in the alpha of the diffuse map.
+    aiMaterial *ai_material = scene->mMaterials[aiMesh->mMaterialIndex];
 
     // return a aiMesh object created from the extracted aiMesh data
-    return mesh(vertices, indices, textures);
+    return mesh(vertices, indices, load_material(ai_material));
 }
 
-std::vector<texture> model::load_material_textures(aiMaterial *mat, aiTextureType type, std::string typeName) {
+std::vector<std::pair<texture_role, mip_source>> model::material_sources(aiMaterial *mat) const {
     using namespace std;
-    vector<texture> textures;
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (auto &j: textures_loaded) {
-            if (std::strcmp(j.path.data(), str.C_Str()) == 0) {
-                textures.push_back(j);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
+    struct map_type {
+        aiTextureType type;
+        texture_role role;
+        bool mask;
+    };
+    // only colour maps are stored as sRGB, the other maps hold linear data
+    const map_type types[] = {
+            {aiTextureType_DIFFUSE,           texture_role::diffuse,   false},
+            {aiTextureType_SPECULAR,          texture_role::specular,  true},
+            {aiTextureType_HEIGHT,            texture_role::normal,    false},
+            {aiTextureType_AMBIENT,           texture_role::height,    true},
+            {aiTextureType_DIFFUSE_ROUGHNESS, texture_role::roughness, true},
+    };
+    vector<pair<texture_role, mip_source>> sources;
+    for (const auto &type: types) {
+        for (unsigned int i = 0; i < mat->GetTextureCount(type.type); i++) {
+            aiString str;
+            mat->GetTexture(type.type, i, &str);
+            mip_source source;
+            source.filename = directory + '/' + str.C_Str();
+            source.srgb = gamma_correction && type.type == aiTextureType_DIFFUSE;
+            source.channels = type.mask && import_options.single_channel_masks ? 1 : 0;
+            sources.emplace_back(type.role, source);
+        }
+    }
+    if (import_options.pack_specular) {
+        // the first specular mask goes into the alpha channel of the first diffuse map
+        auto diffuse = find_if(sources.begin(), sources.end(), [](const auto &s) { return s.first == texture_role::diffuse; });
+        auto specular = find_if(sources.begin(), sources.end(), [](const auto &s) { return s.first == texture_role::specular; });
+        if (diffuse != sources.end() && specular != sources.end()) {
+            diffuse->second.alpha_filename = specular->second.filename;
+            diffuse->second.channels = 4;
+            sources.erase(specular);
         }
-        if (!skip) {   // if texture hasn't been loaded already, load it
-            texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(
-                    texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    }
+    return sources;
+}
+
+material model::load_material(aiMaterial *mat) {
+    using namespace std;
+    // the shaders sample one map per role, the first one of each role wins
+    array<GLuint, TEXTURE_ROLE_COUNT> textures{};
+    bool packed = false;
+    for (const auto &item: material_sources(mat)) {
+        GLuint &slot = textures[static_cast<size_t>(item.first)];
+        if (slot != 0)
+            continue;
+        packed = packed || (item.first == texture_role::diffuse && !item.second.alpha_filename.empty());
+        const string key = item.second.key();
+        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
+        auto loaded = find_if(textures_loaded.begin(), textures_loaded.end(),
+                              [&key](const texture &t) { return t.path == key; });
+        if (loaded != textures_loaded.end()) {
+            slot = loaded->id; // a texture with the same source has already been loaded (optimization)
+            continue;
         }
+        // if texture hasn't been loaded already, load it
+        auto pending = pending_textures.find(key);
+        const mip_chain chain = pending != pending_textures.end() ? pending->second.get() : load_mip_chain(item.second);
+        texture texture;
+        texture.id = upload_mip_chain(chain);
+        texture_residency::instance().track(texture.id, chain);
+        texture.role = item.first;
+        texture.path = key;
+        slot = texture.id;
+        textures_loaded.push_back(
+                texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
     }
-    return textures;
+    return material(textures, packed);
 }
 
 unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma) {
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        stbi_image_free(data);
-        throw std::string("Texture failed to load at path: ") + path;
-    }
+    // the mip chain is filtered on the CPU (in linear space when gamma is set) instead of glGenerateMipmap
+    const mip_chain chain = load_mip_chain(filename, gamma);
+    const unsigned int textureID = upload_mip_chain(chain);
+    texture_residency::instance().track(textureID, chain);
     return textureID;
 }
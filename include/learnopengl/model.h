@@ -6,30 +6,59 @@
 #define CG_MODEL_H
 
 #include "mesh.h"
+#include "occlusion_culling.h"
+#include "mipmap.h"
+#include "texture_residency.h"
 #include "shader_m.h"
-#include "shader_s.h"
 #include "assimp/scene.h"
 #include <algorithm>
 #include "assimp/Importer.hpp"
 #include "assimp/postprocess.h"
 #include "stb_image.h"
+#include <future>
+#include <unordered_map>
 
 unsigned int TextureFromFile(const char *path, const std::string& directory, bool gamma = false);
 
+// how material maps are stored on import
+struct texture_import_options {
+    // store specular, height and roughness maps as one channel (GL_R8) instead of the file's RGB(A)
+    bool single_channel_masks = true;
+    // put the specular mask into the alpha channel of the diffuse map so both need only one sampler
+    bool pack_specular = false;
+};
+
 class model {
 public:
-    explicit model(const std::string& path, bool gamma = false);
+    explicit model(const std::string& path, bool gamma = false, texture_import_options options = {});
+    // the model owns its textures and deletes them
+    ~model();
+    model(const model&) = delete;
+    model& operator=(const model&) = delete;
     void draw(const Shader& shader) const;
+    void submit(render_queue& queue, render_pass pass, const Shader& shader, const glm::mat4& model) const;
+    // queues only the meshes whose bounds intersect the frustum and, given an occlusion buffer that has been
+    // rasterized this frame, are not hidden behind its occluders; returns how many
+    std::size_t submit(render_queue& queue, render_pass pass, const Shader& shader, const glm::mat4& model,
+                       const frustum& view, const occlusion_buffer* occlusion = nullptr) const;
+    std::size_t mesh_count() const { return meshes.size(); }
 private:
     bool gamma_correction;
+    texture_import_options import_options;
     std::vector<texture> textures_loaded;
     std::vector<mesh> meshes;
     std::string directory;
+    // scratch space of the culling submit
+    mutable aabb_list mesh_bounds;
+    mutable std::vector<std::uint32_t> visible_meshes;
+    // mip chains being built on the worker pool while the scene graph is walked, keyed by mip_source::key
+    std::unordered_map<std::string, std::future<mip_chain>> pending_textures;
     void load_model(const std::string& path);
+    void prefetch_textures(const aiScene *scene);
     void process_node(aiNode *node, const aiScene *scene);
     mesh process_mesh(aiMesh *aiMesh, const aiScene *scene);
-    std::vector<texture> load_material_textures(aiMaterial *mat, aiTextureType type,
-                                         std::string typeName);
+    std::vector<std::pair<texture_role, mip_source>> material_sources(aiMaterial *mat) const;
+    material load_material(aiMaterial *mat);
 };
 
 
@@ -0,0 +1,224 @@
+//
+// 软件遮挡剔除：在CPU上把遮挡物光栅化到低分辨率深度缓冲，提交前用它测试物体的包围盒
+//
+
+#include "occlusion_culling.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // clip space w below this counts as behind the near plane
+    constexpr float MIN_W = 1e-4f;
+}
+
+occlusion_buffer::occlusion_buffer(int width, int height) {
+    tilesX = std::max(1, (width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE);
+    tilesY = std::max(1, (height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE);
+    bufferWidth = tilesX * OCCLUSION_TILE_SIZE;
+    bufferHeight = tilesY * OCCLUSION_TILE_SIZE;
+    depthBuffer.assign(static_cast<std::size_t>(bufferWidth) * bufferHeight, 1.0f);
+    tileMax.assign(static_cast<std::size_t>(tilesX) * tilesY, 1.0f);
+}
+
+void occlusion_buffer::begin_frame(const glm::mat4 &matrix) {
+    viewProjection = matrix;
+    triangles.clear();
+    std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+    std::fill(tileMax.begin(), tileMax.end(), 1.0f);
+}
+
+void occlusion_buffer::add_triangles(const float *positions, std::size_t stride, std::size_t vertexCount,
+                                     const glm::mat4 &model) {
+    const glm::mat4 matrix = viewProjection * model;
+    for (std::size_t i = 0; i + 2 < vertexCount; i += 3) {
+        glm::vec4 clip[3];
+        for (int v = 0; v < 3; v++) {
+            const float *p = positions + (i + v) * stride;
+            clip[v] = matrix * glm::vec4(p[0], p[1], p[2], 1.0f);
+        }
+        add_triangle(clip[0], clip[1], clip[2]);
+    }
+}
+
+void occlusion_buffer::add_triangles(const glm::vec3 *positions, const std::uint32_t *indices, std::size_t indexCount,
+                                     const glm::mat4 &model) {
+    const glm::mat4 matrix = viewProjection * model;
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3) {
+        add_triangle(matrix * glm::vec4(positions[indices[i]], 1.0f),
+                     matrix * glm::vec4(positions[indices[i + 1]], 1.0f),
+                     matrix * glm::vec4(positions[indices[i + 2]], 1.0f));
+    }
+}
+
+void occlusion_buffer::add_triangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+    if (a.w < MIN_W || b.w < MIN_W || c.w < MIN_W)
+        return;
+    // to buffer pixels, y up like the window
+    glm::vec3 p[3];
+    const glm::vec4 *clip[3] = {&a, &b, &c};
+    for (int v = 0; v < 3; v++) {
+        const glm::vec3 ndc = glm::vec3(*clip[v]) / clip[v]->w;
+        p[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * bufferWidth, (ndc.y * 0.5f + 0.5f) * bufferHeight,
+                         ndc.z * 0.5f + 0.5f);
+    }
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+    if (std::fabs(area) < 1e-6f)
+        return;
+    // both windings are drawn; swapping two vertices makes every edge function positive inside
+    if (area < 0.0f) {
+        std::swap(p[1], p[2]);
+        area = -area;
+    }
+
+    triangle t{};
+    t.minX = std::max(0, static_cast<int>(std::floor(std::min({p[0].x, p[1].x, p[2].x}))));
+    t.maxX = std::min(bufferWidth - 1, static_cast<int>(std::ceil(std::max({p[0].x, p[1].x, p[2].x}))));
+    t.minY = std::max(0, static_cast<int>(std::floor(std::min({p[0].y, p[1].y, p[2].y}))));
+    t.maxY = std::min(bufferHeight - 1, static_cast<int>(std::ceil(std::max({p[0].y, p[1].y, p[2].y}))));
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+    // edge i runs from vertex i to vertex i + 1; its function is positive on the inner side
+    for (int e = 0; e < 3; e++) {
+        const glm::vec3 &from = p[e];
+        const glm::vec3 &to = p[(e + 1) % 3];
+        t.edgeA[e] = from.y - to.y;
+        t.edgeB[e] = to.x - from.x;
+        t.edgeC[e] = from.x * to.y - from.y * to.x;
+    }
+    // z over the screen is a plane: solve it from the barycentric weights. The weight of vertex i is the
+    // edge function of the opposite edge (i + 1) divided by the area.
+    t.depthA = t.depthB = t.depthC = 0.0f;
+    for (int v = 0; v < 3; v++) {
+        const int e = (v + 1) % 3;
+        t.depthA += p[v].z * t.edgeA[e] / area;
+        t.depthB += p[v].z * t.edgeB[e] / area;
+        t.depthC += p[v].z * t.edgeC[e] / area;
+    }
+    // move the functions to pixel centres, so pixel (x, y) evaluates A x + B y + C
+    for (int e = 0; e < 3; e++)
+        t.edgeC[e] += 0.5f * (t.edgeA[e] + t.edgeB[e]);
+    t.depthC += 0.5f * (t.depthA + t.depthB);
+    triangles.push_back(t);
+}
+
+void occlusion_buffer::rasterize() {
+    thread_pool::shared().parallel_for(0, static_cast<std::size_t>(tilesY), [this](std::size_t row) {
+        rasterize_band(static_cast<int>(row));
+    });
+}
+
+void occlusion_buffer::rasterize_band(int tileRow) {
+    const int bandMinY = tileRow * OCCLUSION_TILE_SIZE;
+    const int bandMaxY = bandMinY + OCCLUSION_TILE_SIZE - 1;
+    for (const auto &t: triangles) {
+        const int minY = std::max(t.minY, bandMinY);
+        const int maxY = std::min(t.maxY, bandMaxY);
+        if (minY > maxY)
+            continue;
+        // rows are walked four pixels at a time from a multiple of four; the width is a multiple of the tile
+        const int minX = t.minX & ~3;
+        for (int y = minY; y <= maxY; y++) {
+            float *row = &depthBuffer[static_cast<std::size_t>(y) * bufferWidth];
+#if defined(CG_SIMD_SSE)
+            const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            const float fy = static_cast<float>(y);
+            __m128 edgeA[3], edgeRow[3];
+            for (int e = 0; e < 3; e++) {
+                edgeA[e] = _mm_set1_ps(t.edgeA[e]);
+                edgeRow[e] = _mm_set1_ps(t.edgeB[e] * fy + t.edgeC[e]);
+            }
+            const __m128 depthA = _mm_set1_ps(t.depthA);
+            const __m128 depthRow = _mm_set1_ps(t.depthB * fy + t.depthC);
+            for (int x = minX; x <= t.maxX; x += 4) {
+                const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), edgeRow[0]), _mm_setzero_ps());
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], px), edgeRow[1]),
+                                                         _mm_setzero_ps()));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], px), edgeRow[2]),
+                                                         _mm_setzero_ps()));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                const __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, px), depthRow);
+                const __m128 old = _mm_loadu_ps(row + x);
+                const __m128 nearer = _mm_min_ps(old, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = minX; x <= t.maxX; x++) {
+                bool inside = true;
+                for (int e = 0; e < 3; e++)
+                    inside = inside && t.edgeA[e] * x + t.edgeB[e] * y + t.edgeC[e] >= 0.0f;
+                if (inside)
+                    row[x] = std::min(row[x], t.depthA * x + t.depthB * y + t.depthC);
+            }
+#endif
+        }
+    }
+    // the farthest depth of every tile in the band
+    for (int tileX = 0; tileX < tilesX; tileX++) {
+        float farthest = 0.0f;
+        for (int y = bandMinY; y <= bandMaxY; y++) {
+            const float *row = &depthBuffer[static_cast<std::size_t>(y) * bufferWidth + tileX * OCCLUSION_TILE_SIZE];
+            for (int x = 0; x < OCCLUSION_TILE_SIZE; x++)
+                farthest = std::max(farthest, row[x]);
+        }
+        tileMax[static_cast<std::size_t>(tileRow) * tilesX + tileX] = farthest;
+    }
+}
+
+bool occlusion_buffer::visible(const aabb &bounds) const {
+    glm::vec3 minimum(1e30f), maximum(-1e30f);
+    for (int corner = 0; corner < 8; corner++) {
+        const glm::vec3 position((corner & 1) ? bounds.max.x : bounds.min.x,
+                                 (corner & 2) ? bounds.max.y : bounds.min.y,
+                                 (corner & 4) ? bounds.max.z : bounds.min.z);
+        const glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+        if (clip.w < MIN_W)
+            return true;
+        const glm::vec3 window = glm::vec3(clip) / clip.w * 0.5f + 0.5f;
+        minimum = glm::min(minimum, window);
+        maximum = glm::max(maximum, window);
+    }
+    // pixels whose centres the rectangle covers, widened by one for safety
+    const int minX = std::max(0, static_cast<int>(std::floor(minimum.x * bufferWidth)) - 1);
+    const int maxX = std::min(bufferWidth - 1, static_cast<int>(std::ceil(maximum.x * bufferWidth)));
+    const int minY = std::max(0, static_cast<int>(std::floor(minimum.y * bufferHeight)) - 1);
+    const int maxY = std::min(bufferHeight - 1, static_cast<int>(std::ceil(maximum.y * bufferHeight)));
+    // off screen: that is for the frustum test to decide
+    if (minX > maxX || minY > maxY)
+        return true;
+    return visible_rect(minX, maxX, minY, maxY, minimum.z);
+}
+
+bool occlusion_buffer::visible_rect(int minX, int maxX, int minY, int maxY, float depth) const {
+    for (int tileY = minY / OCCLUSION_TILE_SIZE; tileY <= maxY / OCCLUSION_TILE_SIZE; tileY++) {
+        for (int tileX = minX / OCCLUSION_TILE_SIZE; tileX <= maxX / OCCLUSION_TILE_SIZE; tileX++) {
+            // every pixel of the tile is nearer than the box
+            if (tileMax[static_cast<std::size_t>(tileY) * tilesX + tileX] < depth)
+                continue;
+            const int x0 = std::max(minX, tileX * OCCLUSION_TILE_SIZE);
+            const int x1 = std::min(maxX, tileX * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+            const int y0 = std::max(minY, tileY * OCCLUSION_TILE_SIZE);
+            const int y1 = std::min(maxY, tileY * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+            for (int y = y0; y <= y1; y++) {
+                const float *row = &depthBuffer[static_cast<std::size_t>(y) * bufferWidth];
+                for (int x = x0; x <= x1; x++) {
+                    if (row[x] >= depth)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void occlusion_buffer::filter(const aabb_list &boxes, std::vector<std::uint32_t> &indices) const {
+    indices.erase(std::remove_if(indices.begin(), indices.end(), [&](std::uint32_t i) {
+        const glm::vec3 center(boxes.cx[i], boxes.cy[i], boxes.cz[i]);
+        const glm::vec3 extent(boxes.ex[i], boxes.ey[i], boxes.ez[i]);
+        return !visible(aabb{center - extent, center + extent});
+    }), indices.end());
+}
@@ -0,0 +1,71 @@
+//
+// 软件遮挡剔除：在CPU上把遮挡物光栅化到低分辨率深度缓冲，提交前用它测试物体的包围盒
+//
+
+#ifndef CG_OCCLUSION_CULLING_H
+#define CG_OCCLUSION_CULLING_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/frustum_culling.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// the depth buffer is split into square tiles that keep the farthest depth they contain
+constexpr int OCCLUSION_TILE_SIZE = 8;
+
+// A low resolution depth buffer drawn on the CPU. Each frame:
+//   begin_frame(projection * view)   clears the buffer
+//   add_triangles(...)               queues the triangles of the occluders
+//   rasterize()                      draws them, one band of tile rows per job on the shared thread pool,
+//                                    four pixels per SSE step, and builds the per tile maximum depth
+//   visible(box) / filter(...)       tests world space bounds against the hierarchy
+// Depth is window z in [0, 1]. Occluder triangles that reach behind the near plane are dropped instead of
+// clipped, which can only make the buffer less occluding. Nothing here touches GL.
+class occlusion_buffer {
+public:
+    // the size is rounded up to whole tiles
+    explicit occlusion_buffer(int width = 256, int height = 144);
+
+    void begin_frame(const glm::mat4 &viewProjection);
+    // non-indexed triangle list; the position of vertex i starts at positions[i * stride] (stride in floats)
+    void add_triangles(const float *positions, std::size_t stride, std::size_t vertexCount, const glm::mat4 &model);
+    // indexed triangle list of tightly packed positions
+    void add_triangles(const glm::vec3 *positions, const std::uint32_t *indices, std::size_t indexCount,
+                       const glm::mat4 &model);
+    void rasterize();
+
+    // false if the box is behind the occluders everywhere it covers; boxes crossing the near plane are visible
+    bool visible(const aabb &bounds) const;
+    // removes the occluded boxes from indices (indices into boxes, e.g. the output of cull_aabbs)
+    void filter(const aabb_list &boxes, std::vector<std::uint32_t> &indices) const;
+
+    int width() const { return bufferWidth; }
+    int height() const { return bufferHeight; }
+    // row major, bottom row first
+    const std::vector<float> &depth() const { return depthBuffer; }
+    std::size_t triangle_count() const { return triangles.size(); }
+
+private:
+    // a triangle set up in buffer pixels: edge functions and depth plane evaluated at pixel centres
+    struct triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    int bufferWidth, bufferHeight;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection{1.0f};
+    std::vector<float> depthBuffer;
+    std::vector<float> tileMax;
+    std::vector<triangle> triangles;
+
+    void add_triangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+    void rasterize_band(int tileRow);
+    bool visible_rect(int minX, int maxX, int minY, int maxY, float depth) const;
+};
+
+
+#endif //CG_OCCLUSION_CULLING_H
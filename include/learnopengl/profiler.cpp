@@ -0,0 +1,374 @@
+//
+// 性能分析：嵌套的CPU计时区间和GPU时间戳查询，按名字统计最小/平均/p99，导出Chrome trace
+//
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace {
+    // the track GPU scopes are drawn on in the trace
+    constexpr int GPU_THREAD = 0;
+    // gpuStack entry of a scope opened while not recording
+    constexpr std::size_t NOT_RECORDED = ~std::size_t(0);
+
+    struct open_scope {
+        const char *name;
+        double start;
+    };
+    thread_local std::vector<open_scope> cpuStack;
+    thread_local int cachedThread = -1;
+
+    std::string escape(const char *text) {
+        std::string result;
+        for (const char *c = text; *c; c++) {
+            if (*c == '"' || *c == '\\')
+                result += '\\';
+            result += *c;
+        }
+        return result;
+    }
+}
+
+profiler &profiler::instance() {
+    static profiler profiler;
+    return profiler;
+}
+
+profiler::profiler() : epoch(std::chrono::steady_clock::now()) {
+    threadNames.emplace_back("GPU");
+}
+
+double profiler::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+int profiler::thread_id() {
+    if (cachedThread < 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = threadIds.find(std::this_thread::get_id());
+        if (it == threadIds.end()) {
+            it = threadIds.emplace(std::this_thread::get_id(), static_cast<int>(threadNames.size())).first;
+            threadNames.push_back("thread " + std::to_string(it->second));
+        }
+        cachedThread = it->second;
+    }
+    return cachedThread;
+}
+
+const char *profiler::intern(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.insert(name).first->c_str();
+}
+
+void profiler::name_thread(const std::string &name) {
+    const int id = thread_id();
+    std::lock_guard<std::mutex> lock(mutex);
+    threadNames[id] = name;
+}
+
+void profiler::set_enabled(bool value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    enabled = value;
+    if (value)
+        return;
+    // forget the frame in progress and the GPU frames not read yet, so that nothing is queried or kept
+    std::vector<event>().swap(cpuEvents);
+    for (auto &frame: gpuFrames) {
+        frame.events.clear();
+        frame.used = 0;
+        frame.pending = false;
+    }
+    inFrame = false;
+}
+
+void profiler::begin_cpu(const char *name) {
+    // scopes opened while disabled only leave a marker, so that every end pops its own begin
+    if (!enabled) {
+        cpuStack.push_back(open_scope{nullptr, 0.0});
+        return;
+    }
+    cpuStack.push_back(open_scope{name, now()});
+}
+
+void profiler::end_cpu() {
+    if (cpuStack.empty())
+        return;
+    const open_scope scope = cpuStack.back();
+    cpuStack.pop_back();
+    // a scope that was open when the profiler was disabled is dropped as well
+    if (!scope.name || !enabled)
+        return;
+    const event e{scope.name, thread_id(), static_cast<int>(cpuStack.size()), scope.start, now() - scope.start};
+    std::lock_guard<std::mutex> lock(mutex);
+    // set_enabled(false) may have cleared the events since the check above
+    if (enabled)
+        cpuEvents.push_back(e);
+}
+
+GLuint profiler::next_query(gpu_frame &frame) {
+    if (frame.used == frame.queries.size()) {
+        // grow the pool in steps; the queries are reused by every later frame of this slot
+        const std::size_t grow = std::max<std::size_t>(32, frame.queries.size());
+        frame.queries.resize(frame.queries.size() + grow);
+        glGenQueries(static_cast<GLsizei>(grow), frame.queries.data() + frame.used);
+    }
+    return frame.queries[frame.used++];
+}
+
+void profiler::begin_gpu(const char *name) {
+    if (!enabled || !inFrame) {
+        gpuStack.push_back(NOT_RECORDED);
+        return;
+    }
+    gpu_frame &frame = gpuFrames[frameNumber % GPU_FRAMES];
+    gpu_event e{name, static_cast<int>(gpuStack.size()), next_query(frame), 0};
+    glQueryCounter(e.begin, GL_TIMESTAMP);
+    gpuStack.push_back(frame.events.size());
+    frame.events.push_back(e);
+}
+
+void profiler::end_gpu() {
+    if (gpuStack.empty())
+        return;
+    const std::size_t index = gpuStack.back();
+    gpuStack.pop_back();
+    if (index == NOT_RECORDED || !inFrame)
+        return;
+    gpu_frame &frame = gpuFrames[frameNumber % GPU_FRAMES];
+    const GLuint query = next_query(frame);
+    gpu_event &e = frame.events[index];
+    e.end = query;
+    glQueryCounter(e.end, GL_TIMESTAMP);
+}
+
+void profiler::collect(gpu_frame &frame, std::vector<event> &events) {
+    frame.pending = false;
+    // timestamps complete in order, so the last query stands for the whole frame
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    std::unordered_map<std::string, double> totals;
+    for (const auto &e: frame.events) {
+        if (e.end == 0)
+            continue; // not closed before end_frame
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(e.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(e.end, GL_QUERY_RESULT, &end);
+        const double start =
+            frame.cpuStart + static_cast<double>(static_cast<GLint64>(begin) - frame.gpuStart) * 1e-3;
+        const double duration = static_cast<double>(end - std::min(begin, end)) * 1e-3;
+        events.push_back(event{e.name, GPU_THREAD, e.depth, start, duration});
+        totals[e.name] += duration * 1e-3;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (frame.number < statsStart)
+        return;
+    for (const auto &total: totals)
+        add_sample(gpuSeries, total.first, total.second);
+}
+
+void profiler::begin_frame() {
+    if (!enabled)
+        return;
+    gpu_frame &frame = gpuFrames[frameNumber % GPU_FRAMES];
+    std::vector<event> gpuEvents;
+    if (frame.pending)
+        collect(frame, gpuEvents);
+    frame.events.clear();
+    frame.used = 0;
+    frame.cpuStart = now();
+    frame.number = frameNumber;
+    glGetInteger64v(GL_TIMESTAMP, &frame.gpuStart);
+    gpuStack.clear();
+    inFrame = true;
+    if (!gpuEvents.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cpuEvents.insert(cpuEvents.end(), gpuEvents.begin(), gpuEvents.end());
+    }
+}
+
+void profiler::end_frame() {
+    if (!inFrame)
+        return;
+    inFrame = false;
+    gpuStack.clear();
+    gpu_frame &frame = gpuFrames[frameNumber % GPU_FRAMES];
+    frame.pending = frame.used > 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<std::string, double> totals;
+    for (const auto &e: cpuEvents) {
+        if (e.thread != GPU_THREAD)
+            totals[e.name] += e.duration * 1e-3;
+    }
+    for (const auto &total: totals)
+        add_sample(cpuSeries, total.first, total.second);
+    trace.push_back(std::move(cpuEvents));
+    cpuEvents.clear();
+    if (trace.size() > TRACE_FRAMES)
+        trace.pop_front();
+    frameNumber++;
+}
+
+void profiler::add_sample(std::unordered_map<std::string, series> &all, const std::string &name, double ms) const {
+    series &s = all[name];
+    s.samples.push_back(ms);
+    while (s.samples.size() > window)
+        s.samples.pop_front();
+}
+
+void profiler::set_window(std::size_t frames) {
+    std::lock_guard<std::mutex> lock(mutex);
+    window = std::max<std::size_t>(frames, 1);
+}
+
+void profiler::clear_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cpuSeries.clear();
+    gpuSeries.clear();
+    statsStart = frameNumber;
+}
+
+profiler::stats profiler::summarise(const series &s) {
+    stats result;
+    result.samples = s.samples.size();
+    if (s.samples.empty())
+        return result;
+    std::vector<double> sorted(s.samples.begin(), s.samples.end());
+    std::sort(sorted.begin(), sorted.end());
+    result.min_ms = sorted.front();
+    double sum = 0.0;
+    for (double sample: sorted)
+        sum += sample;
+    result.avg_ms = sum / static_cast<double>(sorted.size());
+    // nearest rank
+    const auto percentile = [&sorted](double p) {
+        const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::max<std::size_t>(rank, 1) - 1];
+    };
+    result.p50_ms = percentile(0.5);
+    result.p90_ms = percentile(0.9);
+    result.p99_ms = percentile(0.99);
+    result.max_ms = sorted.back();
+    return result;
+}
+
+profiler::stats profiler::cpu_stats(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cpuSeries.find(name);
+    return it != cpuSeries.end() ? summarise(it->second) : stats{};
+}
+
+profiler::stats profiler::gpu_stats(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = gpuSeries.find(name);
+    return it != gpuSeries.end() ? summarise(it->second) : stats{};
+}
+
+std::string profiler::report() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, std::pair<stats, stats>> rows;
+    for (const auto &s: cpuSeries)
+        rows[s.first].first = summarise(s.second);
+    for (const auto &s: gpuSeries)
+        rows[s.first].second = summarise(s.second);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << std::left << std::setw(24) << "scope" << "   CPU min/avg/p99 ms          GPU min/avg/p99 ms\n";
+    for (const auto &row: rows) {
+        out << std::left << std::setw(24) << row.first;
+        for (const stats *s: {&row.second.first, &row.second.second}) {
+            if (s->samples == 0)
+                out << "   " << std::setw(26) << "-";
+            else
+                out << "   " << std::setw(8) << s->min_ms << ' ' << std::setw(8) << s->avg_ms << ' '
+                    << std::setw(8) << s->p99_ms;
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+bool profiler::write_chrome_trace(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (std::size_t i = 0; i < threadNames.size(); i++) {
+        file << (first ? "" : ",\n") << R"({"name":"thread_name","ph":"M","pid":0,"tid":)" << i
+             << R"(,"args":{"name":")" << escape(threadNames[i].c_str()) << "\"}}";
+        first = false;
+    }
+    for (const auto &frame: trace) {
+        for (const auto &e: frame) {
+            file << ",\n" << R"({"name":")" << escape(e.name) << R"(","ph":"X","pid":0,"tid":)" << e.thread
+                 << R"(,"ts":)" << e.start << R"(,"dur":)" << e.duration << "}";
+        }
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+bool profiler::write_stats_json(const std::string &path,
+                                const std::vector<std::pair<std::string, std::string>> &info) const {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, std::pair<const series *, const series *>> rows;
+    for (const auto &s: cpuSeries)
+        rows[s.first].first = &s.second;
+    for (const auto &s: gpuSeries)
+        rows[s.first].second = &s.second;
+    const auto write = [&file](const char *key, const series *s) {
+        file << '"' << key << "\":";
+        if (!s) {
+            file << "null";
+            return;
+        }
+        const stats st = summarise(*s);
+        file << R"({"samples":)" << st.samples << R"(,"min_ms":)" << st.min_ms << R"(,"avg_ms":)" << st.avg_ms
+             << R"(,"p50_ms":)" << st.p50_ms << R"(,"p90_ms":)" << st.p90_ms << R"(,"p99_ms":)" << st.p99_ms
+             << R"(,"max_ms":)" << st.max_ms << '}';
+    };
+    file << std::fixed << std::setprecision(4);
+    file << "{\"info\":{";
+    bool first = true;
+    for (const auto &field: info) {
+        file << (first ? "\n" : ",\n") << "  \"" << escape(field.first.c_str()) << "\":\""
+             << escape(field.second.c_str()) << '"';
+        first = false;
+    }
+    file << "\n},\n\"scopes\":{";
+    first = true;
+    for (const auto &row: rows) {
+        file << (first ? "\n" : ",\n") << "  \"" << escape(row.first.c_str()) << "\":{";
+        write("cpu", row.second.first);
+        file << ',';
+        write("gpu", row.second.second);
+        file << '}';
+        first = false;
+    }
+    file << "\n}}\n";
+    return static_cast<bool>(file);
+}
+
+void profiler::release_gpu() {
+    for (auto &frame: gpuFrames) {
+        if (!frame.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        frame = gpu_frame{};
+    }
+    gpuStack.clear();
+    inFrame = false;
+}
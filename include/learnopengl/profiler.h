@@ -0,0 +1,173 @@
+//
+// 性能分析：嵌套的CPU计时区间和GPU时间戳查询，按名字统计最小/平均/p99，导出Chrome trace
+//
+
+#ifndef CG_PROFILER_H
+#define CG_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Scopes are named by string literals (or interned names), nest freely and are timed per frame:
+//   CPU scopes can be opened on any thread, each thread keeps its own stack.
+//   GPU scopes run on the GL thread. Their start and end are glQueryCounter(GL_TIMESTAMP) queries, so they nest
+//   as well (GL_TIME_ELAPSED queries can't). Every frame in flight has its own pool of queries; a pool is read
+//   when it comes round again, and only if the GPU finished it, so reading never stalls. A frame whose queries
+//   aren't done yet is dropped from the GPU statistics.
+// Per name the time of each frame (the sum of all its scopes) goes into a rolling window for min/avg/percentiles.
+// The scopes of the last frames are kept for write_chrome_trace(), GPU scopes on a track of their own, moved
+// onto the CPU clock with a timestamp taken at the start of their frame.
+class profiler {
+public:
+    struct stats {
+        double min_ms = 0.0;
+        double avg_ms = 0.0;
+        double p50_ms = 0.0;
+        double p90_ms = 0.0;
+        double p99_ms = 0.0;
+        double max_ms = 0.0;
+        std::size_t samples = 0;
+    };
+
+    static profiler &instance();
+
+    // GL thread, between frames only. A disabled profiler does no timing and no GL queries and keeps no events; the
+    // statistics and the trace so far stay
+    void set_enabled(bool value);
+    bool is_enabled() const { return enabled; }
+    // how many of the latest frames the statistics cover, 240 by default
+    void set_window(std::size_t frames);
+    // forgets the statistics so far, e.g. after warming up
+    void clear_stats();
+
+    // GL thread, once per frame around everything else
+    void begin_frame();
+    void end_frame();
+
+    void begin_cpu(const char *name);
+    void end_cpu();
+    // GL thread only
+    void begin_gpu(const char *name);
+    void end_gpu();
+
+    // a name that lives as long as the profiler, for scopes named at run time
+    const char *intern(const std::string &name);
+    // name of the calling thread in the trace
+    void name_thread(const std::string &name);
+
+    stats cpu_stats(const std::string &name) const;
+    stats gpu_stats(const std::string &name) const;
+    // one line per scope name with its CPU and GPU statistics
+    std::string report() const;
+    // Chrome trace event format (chrome://tracing, Perfetto); returns false if the file can't be written
+    bool write_chrome_trace(const std::string &path) const;
+    // the statistics of every scope as JSON, with info written as an object of strings next to them; returns false
+    // if the file can't be written
+    bool write_stats_json(const std::string &path,
+                          const std::vector<std::pair<std::string, std::string>> &info = {}) const;
+
+    // deletes the queries; call before the GL context goes away
+    void release_gpu();
+
+private:
+    static constexpr int GPU_FRAMES = 3;
+    static constexpr std::size_t TRACE_FRAMES = 300;
+
+    struct event {
+        const char *name;
+        int thread;
+        int depth;
+        // microseconds since the profiler was created
+        double start;
+        double duration;
+    };
+    struct gpu_event {
+        const char *name;
+        int depth;
+        GLuint begin;
+        GLuint end;
+    };
+    struct gpu_frame {
+        std::vector<gpu_event> events;
+        std::vector<GLuint> queries;
+        std::size_t used = 0;
+        // CPU and GPU clocks at the start of the frame
+        double cpuStart = 0.0;
+        GLint64 gpuStart = 0;
+        std::size_t number = 0;
+        bool pending = false;
+    };
+    struct series {
+        std::deque<double> samples;
+    };
+
+    profiler();
+
+    std::atomic<bool> enabled{true};
+    std::chrono::steady_clock::time_point epoch;
+
+    mutable std::mutex mutex;
+    std::unordered_set<std::string> names;
+    std::unordered_map<std::thread::id, int> threadIds;
+    std::vector<std::string> threadNames;
+    // CPU scopes finished since begin_frame, from all threads
+    std::vector<event> cpuEvents;
+    std::unordered_map<std::string, series> cpuSeries;
+    std::unordered_map<std::string, series> gpuSeries;
+    std::size_t window = 240;
+    // GPU timings of frames before this one arrive after clear_stats() and are left out
+    std::size_t statsStart = 0;
+    std::deque<std::vector<event>> trace;
+    std::size_t frameNumber = 0;
+
+    // GL thread only
+    gpu_frame gpuFrames[GPU_FRAMES];
+    std::vector<std::size_t> gpuStack;
+    bool inFrame = false;
+
+    double now() const;
+    int thread_id();
+    GLuint next_query(gpu_frame &frame);
+    void collect(gpu_frame &frame, std::vector<event> &events);
+    void add_sample(std::unordered_map<std::string, series> &all, const std::string &name, double ms) const;
+    static stats summarise(const series &s);
+};
+
+// times the enclosing block on the calling thread
+class cpu_scope {
+public:
+    explicit cpu_scope(const char *name) { profiler::instance().begin_cpu(name); }
+    ~cpu_scope() { profiler::instance().end_cpu(); }
+    cpu_scope(const cpu_scope &) = delete;
+    cpu_scope &operator=(const cpu_scope &) = delete;
+};
+
+// times the enclosing block on the CPU and the GL commands it issues on the GPU; GL thread only
+class gpu_scope {
+public:
+    explicit gpu_scope(const char *name) {
+        profiler::instance().begin_cpu(name);
+        profiler::instance().begin_gpu(name);
+    }
+    ~gpu_scope() {
+        profiler::instance().end_gpu();
+        profiler::instance().end_cpu();
+    }
+    gpu_scope(const gpu_scope &) = delete;
+    gpu_scope &operator=(const gpu_scope &) = delete;
+};
+
+
+#endif //CG_PROFILER_H
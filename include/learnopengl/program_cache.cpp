@@ -0,0 +1,130 @@
+//
+// 着色器程序二进制缓存，热启动时跳过编译和链接
+//
+
+#include "program_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    constexpr std::uint32_t magic = 0x42504743; // "CGPB"
+
+    std::uint64_t fnv1a(std::uint64_t hash, const std::string &data) {
+        for (unsigned char c: data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        // separator so that ("ab", "c") and ("a", "bc") differ
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+        return hash;
+    }
+
+    std::string gl_string(GLenum name) {
+        const auto *value = reinterpret_cast<const char *>(glGetString(name));
+        return value ? value : "";
+    }
+}
+
+program_cache &program_cache::instance() {
+    static program_cache cache;
+    return cache;
+}
+
+bool program_cache::supported() {
+    if (support < 0) {
+        GLint formats = 0;
+        if (glGetProgramBinary && glProgramBinary && glProgramParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        support = formats > 0 ? 1 : 0;
+        driver = gl_string(GL_VENDOR) + '|' + gl_string(GL_RENDERER) + '|' + gl_string(GL_VERSION);
+    }
+    return support == 1;
+}
+
+std::uint64_t program_cache::key(const std::string &vertexCode, const std::string &fragmentCode) {
+    supported();
+    std::uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(hash, driver);
+    hash = fnv1a(hash, vertexCode);
+    hash = fnv1a(hash, fragmentCode);
+    return hash;
+}
+
+std::string program_cache::file_name(std::uint64_t key) const {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return directory + '/' + name + ".bin";
+}
+
+GLuint program_cache::load(std::uint64_t key) {
+    if (!supported())
+        return 0;
+    const std::string path = file_name(key);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return 0;
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+    // a file that's cut short, not ours or refused by the driver is deleted, the program is compiled from source
+    const auto reject = [&file, &path]() -> GLuint {
+        file.close();
+        std::remove(path.c_str());
+        return 0;
+    };
+    std::uint32_t header = 0;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || header != magic)
+        return reject();
+    GLenum format = 0;
+    std::uint32_t length = 0;
+    file.read(reinterpret_cast<char *>(&format), sizeof(format));
+    file.read(reinterpret_cast<char *>(&length), sizeof(length));
+    // the length comes from the file; it can't be more than what follows it
+    if (!file || length == 0 || static_cast<std::streamoff>(length) > fileSize - file.tellg())
+        return reject();
+    std::vector<char> binary(length);
+    file.read(binary.data(), length);
+    if (!file)
+        return reject();
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(length));
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // the driver refused it (e.g. it changed without changing its version string)
+        glDeleteProgram(program);
+        return reject();
+    }
+    return program;
+}
+
+void program_cache::store(std::uint64_t key, GLuint program) {
+    if (!supported())
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::ofstream file(file_name(key), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "ERROR::SHADER::PROGRAM_CACHE_NOT_WRITABLE: " << file_name(key) << std::endl;
+        return;
+    }
+    const auto size = static_cast<std::uint32_t>(length);
+    file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+    file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(binary.data(), length);
+}
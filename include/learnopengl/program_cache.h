@@ -0,0 +1,37 @@
+//
+// 着色器程序二进制缓存，热启动时跳过编译和链接
+//
+
+#ifndef CG_PROGRAM_CACHE_H
+#define CG_PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// Stores linked programs with glGetProgramBinary and restores them with glProgramBinary. The key covers the
+// full shader sources (defines included) and the driver's vendor/renderer/version, so a driver update or an
+// edited shader simply misses. Needs a current GL context.
+class program_cache {
+public:
+    static program_cache &instance();
+
+    void set_directory(const std::string &path) { directory = path; }
+    // false when the driver offers no binary formats, every call is then a no-op
+    bool supported();
+
+    std::uint64_t key(const std::string &vertexCode, const std::string &fragmentCode);
+    // a linked program restored from the cache, or 0 if there is none or the driver rejects it
+    GLuint load(std::uint64_t key);
+    // program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void store(std::uint64_t key, GLuint program);
+
+private:
+    std::string directory = "shader_cache";
+    std::string driver;
+    int support = -1;
+    std::string file_name(std::uint64_t key) const;
+};
+
+
+#endif //CG_PROGRAM_CACHE_H
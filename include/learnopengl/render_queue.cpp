@@ -0,0 +1,230 @@
+//
+// 渲染队列：绘制命令按64位排序键排序后再执行，减少状态切换
+//
+
+#include "render_queue.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+    constexpr int PASS_SHIFT = 60;
+    constexpr int PROGRAM_SHIFT = 48;
+    constexpr int MATERIAL_SHIFT = 32;
+    constexpr int VAO_SHIFT = 20;
+    constexpr std::uint64_t DEPTH_MAX = (1u << 20) - 1;
+
+    // dense id of a state object, assigned in order of first use
+    template<class Key>
+    std::uint64_t dense_id(std::unordered_map<Key, std::uint32_t> &ids, Key key, std::uint64_t mask) {
+        auto it = ids.emplace(key, static_cast<std::uint32_t>(ids.size())).first;
+        return it->second & mask;
+    }
+
+    void radix_sort(std::vector<std::uint64_t> &keys, std::vector<std::uint32_t> &values,
+                    std::vector<std::uint64_t> &keyScratch, std::vector<std::uint32_t> &valueScratch) {
+        const std::size_t n = keys.size();
+        keyScratch.resize(n);
+        valueScratch.resize(n);
+        for (int shift = 0; shift < 64; shift += 8) {
+            std::size_t counts[256] = {};
+            for (std::uint64_t key: keys)
+                counts[(key >> shift) & 0xFF]++;
+            // every key has the same byte here, nothing to do (common for the unused high id bits)
+            if (n == 0 || counts[(keys[0] >> shift) & 0xFF] == n)
+                continue;
+            std::size_t offset = 0;
+            for (std::size_t &count: counts) {
+                const std::size_t c = count;
+                count = offset;
+                offset += c;
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                const std::size_t slot = counts[(keys[i] >> shift) & 0xFF]++;
+                keyScratch[slot] = keys[i];
+                valueScratch[slot] = values[i];
+            }
+            std::swap(keys, keyScratch);
+            std::swap(values, valueScratch);
+        }
+    }
+}
+
+render_queue::~render_queue() {
+    if (instanceBuffer != 0)
+        glDeleteBuffers(1, &instanceBuffer);
+}
+
+void render_queue::begin_frame(const glm::mat4 &viewMatrix, float farPlane) {
+    view = viewMatrix;
+    far = farPlane;
+    commands.clear();
+    keys.clear();
+    order.clear();
+    frameStats = render_stats{};
+}
+
+void render_queue::submit(render_pass pass, const draw_command &command) {
+    const std::uint64_t materialHash = command.mat ? command.mat->state_hash() : 0;
+    // depth of the object's origin
+    const float depth = -(view * command.model[3]).z;
+    const auto quantised = static_cast<std::uint64_t>(std::min(std::max(depth / far, 0.0f), 1.0f) * DEPTH_MAX);
+
+    std::uint64_t key = static_cast<std::uint64_t>(pass) << PASS_SHIFT;
+    key |= dense_id(programIds, command.shader ? command.shader->ID : 0u, 0xFFF) << PROGRAM_SHIFT;
+    key |= dense_id(materialIds, materialHash, 0xFFFF) << MATERIAL_SHIFT;
+    key |= dense_id(vertexArrayIds, command.vao, 0xFFF) << VAO_SHIFT;
+    key |= pass == render_pass::opaque ? quantised : DEPTH_MAX - quantised;
+
+    keys.push_back(key);
+    order.push_back(static_cast<std::uint32_t>(commands.size()));
+    commands.push_back(command);
+}
+
+void render_queue::sort() {
+    radix_sort(keys, order, keyScratch, orderScratch);
+}
+
+void render_queue::execute(render_pass pass) {
+    record(pass);
+    replay();
+}
+
+void render_queue::execute() {
+    record();
+    replay();
+}
+
+std::size_t render_queue::record(render_pass pass) {
+    const std::uint64_t begin = static_cast<std::uint64_t>(pass) << PASS_SHIFT;
+    const std::uint64_t end = (static_cast<std::uint64_t>(pass) + 1) << PASS_SHIFT;
+    const auto from = std::lower_bound(keys.begin(), keys.end(), begin) - keys.begin();
+    const auto to = std::lower_bound(keys.begin(), keys.end(), end) - keys.begin();
+    return record_range(static_cast<std::size_t>(from), static_cast<std::size_t>(to));
+}
+
+std::size_t render_queue::record() {
+    return record_range(0, keys.size());
+}
+
+std::size_t render_queue::batch_end(std::size_t begin, std::size_t end) const {
+    const draw_command &head = commands[order[begin]];
+    if (!head.instanced)
+        return begin + 1;
+    const std::uint64_t materialHash = head.mat ? head.mat->state_hash() : 0;
+    std::size_t i = begin + 1;
+    for (; i < end; i++) {
+        const draw_command &command = commands[order[i]];
+        if (command.shader != head.shader || command.instanced != head.instanced || command.vao != head.vao ||
+            command.mode != head.mode || command.indexed != head.indexed || command.first != head.first ||
+            command.count != head.count || (command.mat ? command.mat->state_hash() : 0) != materialHash ||
+            command.lights != head.lights)
+            break;
+    }
+    return i;
+}
+
+void render_queue::record_chunk(std::size_t begin, std::size_t end, command_list &list, render_stats &stats) const {
+    list.clear();
+    const Shader *currentShader = nullptr;
+    std::uint64_t currentMaterial = 0;
+    GLuint currentVao = 0;
+    bool first = true;
+    for (std::size_t i = begin; i < end;) {
+        const draw_command &command = commands[order[i]];
+        const std::size_t next = batch_end(i, end);
+        const bool instanced = next - i > 1;
+        const Shader *shader = instanced ? command.instanced : command.shader;
+        const bool programChanged = first || shader != currentShader;
+        if (programChanged) {
+            list.use_program(shader);
+            currentShader = shader;
+            stats.program_changes++;
+        }
+        // material uniforms are per program, so they are set again after a program change (the uniform cache
+        // makes that free when nothing changed)
+        const std::uint64_t materialHash = command.mat ? command.mat->state_hash() : 0;
+        const bool materialChanged = first || materialHash != currentMaterial;
+        if ((programChanged || materialChanged) && command.mat)
+            list.bind_material(command.mat, shader);
+        if (materialChanged) {
+            currentMaterial = materialHash;
+            stats.material_changes++;
+        }
+        if (first || command.vao != currentVao) {
+            list.bind_vertex_array(command.vao);
+            currentVao = command.vao;
+            stats.vertex_array_changes++;
+        }
+        first = false;
+        if (command.lights.count >= 0)
+            list.set_lights(shader, command.lights);
+
+        if (instanced) {
+            glm::mat4 *models = list.set_instance_range(next - i);
+            for (std::size_t j = i; j < next; j++)
+                *models++ = commands[order[j]].model;
+            list.draw(command.mode, command.indexed, command.first, command.count, static_cast<GLsizei>(next - i));
+            stats.instanced_draws++;
+            stats.instances += next - i;
+        } else {
+            list.set_model(shader, command.model);
+            list.draw(command.mode, command.indexed, command.first, command.count);
+        }
+        stats.draws++;
+        i = next;
+    }
+}
+
+void render_queue::partition(std::size_t begin, std::size_t end, std::size_t maxChunks) {
+    // long runs of one program aren't cut into chunks shorter than this, waking a worker costs more
+    constexpr std::size_t MIN_CHUNK = 64;
+    const std::size_t chunkSize = std::max(MIN_CHUNK, (end - begin + maxChunks - 1) / maxChunks);
+    chunkBounds.clear();
+    chunkBounds.push_back(begin);
+    for (std::size_t i = begin + 1; i < end; i++) {
+        const std::size_t start = chunkBounds.back();
+        const bool programChanged = keys[i] >> PROGRAM_SHIFT != keys[i - 1] >> PROGRAM_SHIFT;
+        // an instanced run doesn't continue past a change of program, material or vertex array
+        if (!programChanged && (i - start < chunkSize || (keys[i] >> VAO_SHIFT == keys[i - 1] >> VAO_SHIFT &&
+                                                          commands[order[i - 1]].instanced)))
+            continue;
+        // the chunks so far, this one and those the rest of the range needs must fit
+        if (chunkBounds.size() + (end - i + chunkSize - 1) / chunkSize <= maxChunks)
+            chunkBounds.push_back(i);
+    }
+    chunkBounds.push_back(end);
+}
+
+std::size_t render_queue::record_range(std::size_t begin, std::size_t end) {
+    listCount = 0;
+    if (begin == end)
+        return 0;
+    auto &pool = thread_pool::shared();
+    partition(begin, end, maxLists > 0 ? maxLists : pool.size() + 1);
+    listCount = chunkBounds.size() - 1;
+    if (lists.size() < listCount)
+        lists.resize(listCount);
+    listStats.assign(listCount, render_stats{});
+    pool.parallel_for(0, listCount, [&](std::size_t chunk) {
+        cpu_scope scope("record commands");
+        record_chunk(chunkBounds[chunk], chunkBounds[chunk + 1], lists[chunk], listStats[chunk]);
+    });
+    return listCount;
+}
+
+void render_queue::replay() {
+    cpu_scope scope("replay commands");
+    for (std::size_t chunk = 0; chunk < listCount; chunk++) {
+        lists[chunk].replay(ring, instanceBuffer);
+        frameStats.draws += listStats[chunk].draws;
+        frameStats.instanced_draws += listStats[chunk].instanced_draws;
+        frameStats.instances += listStats[chunk].instances;
+        frameStats.program_changes += listStats[chunk].program_changes;
+        frameStats.material_changes += listStats[chunk].material_changes;
+        frameStats.vertex_array_changes += listStats[chunk].vertex_array_changes;
+    }
+    listCount = 0;
+}
@@ -0,0 +1,146 @@
+//
+// 渲染队列：绘制命令按64位排序键排序后再执行，减少状态切换
+//
+
+#ifndef CG_RENDER_QUEUE_H
+#define CG_RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/material.h>
+#include <learnopengl/ring_buffer.h>
+#include <learnopengl/command_list.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// first of the four attribute locations (a mat4) the INSTANCING shaders read the model matrix from
+constexpr GLuint INSTANCE_MODEL_ATTRIBUTE = 7;
+
+// passes run in this order; deferred shading executes them one at a time
+enum class render_pass : std::uint8_t {
+    // lit geometry: the forward lighting or the G-buffer programs
+    opaque = 0,
+    // drawn forward after the lighting, e.g. the light cubes
+    unlit = 1,
+};
+
+struct draw_command {
+    const Shader *shader = nullptr;
+    // the same program compiled with INSTANCING, nullptr if there is none (yet). Runs of commands that differ
+    // only in the model matrix are then drawn with one instanced call.
+    const Shader *instanced = nullptr;
+    GLuint vao = 0;
+    GLenum mode = GL_TRIANGLES;
+    // glDrawElements with GL_UNSIGNED_INT indices if indexed, glDrawArrays from first otherwise
+    bool indexed = false;
+    GLint first = 0;
+    GLsizei count = 0;
+    // nullptr for untextured draws
+    const material *mat = nullptr;
+    glm::mat4 model{1.0f};
+    // lights of the OBJECT_LIGHTS programs; only equal lists are drawn as instances of one call
+    object_lights lights;
+};
+
+// what execute() had to change, per frame
+struct render_stats {
+    // GL draw calls, an instanced call counts once
+    std::size_t draws = 0;
+    std::size_t instanced_draws = 0;
+    std::size_t instances = 0;
+    std::size_t program_changes = 0;
+    std::size_t material_changes = 0;
+    std::size_t vertex_array_changes = 0;
+
+    std::size_t state_changes() const { return program_changes + material_changes + vertex_array_changes; }
+};
+
+// Draws are submitted in any order and sorted by a 64 bit key, most significant first:
+//   pass (4 bits) | program (12) | material (16) | vertex array (12) | depth (20)
+// so draws sharing a program, material and vertex array end up next to each other, and inside such a group
+// opaque draws go front to back for early-z. Programs, material state hashes and vertex arrays get small ids the first
+// time they are seen; ids that don't fit only make the grouping worse, execute() compares the real state.
+// After sorting, consecutive commands with the same program, material, vertex array, range and light list are
+// batched: their model matrices go to an instance buffer (attributes INSTANCE_MODEL_ATTRIBUTE..+3, divisor 1) and
+// the run is drawn once with the INSTANCING variant of the program.
+// execute() doesn't call GL while it walks the sorted commands: the range is cut into chunks that worker threads of
+// the shared pool record into command_lists in parallel, and the calling (GL) thread then replays the lists in order.
+// Chunks start where the program changes, so every program's draws are recorded by one thread, as long as that
+// leaves enough lists for the rest of the range; a long run of one program is cut into chunks of equal size, but
+// never inside a run that is drawn as instances of one call. The draws are therefore the same ones in the same
+// order for any number of lists; only the state is set again at the start of each list.
+class render_queue {
+public:
+    render_queue() = default;
+    ~render_queue();
+    render_queue(const render_queue &) = delete;
+    render_queue &operator=(const render_queue &) = delete;
+
+    // clears the queue; depth is measured along the view direction and quantised over [0, far]
+    void begin_frame(const glm::mat4 &view, float far);
+    void submit(render_pass pass, const draw_command &command);
+    // sorts the commands with an LSD radix sort, once per frame after the last submit
+    void sort();
+    // issues the sorted commands of one pass, or of all passes: record() and then replay()
+    void execute(render_pass pass);
+    void execute();
+    // records the sorted commands of one pass, or of all passes, into command lists without calling GL; returns the
+    // number of lists
+    std::size_t record(render_pass pass);
+    std::size_t record();
+    // replays the lists of the last record() in order on the GL thread and adds their statistics to stats()
+    void replay();
+    const command_list &recorded(std::size_t list) const { return lists[list]; }
+
+    // at most this many lists are recorded, 0 for one per thread of the shared pool
+    void set_max_lists(std::size_t count) { maxLists = count; }
+
+    // instance matrices are written into the ring instead of an orphaned buffer; nullptr goes back to orphaning
+    void set_ring(ring_buffer *frameRing) { ring = frameRing; }
+
+    const render_stats &stats() const { return frameStats; }
+    std::size_t size() const { return commands.size(); }
+
+private:
+    glm::mat4 view{1.0f};
+    float far = 100.0f;
+
+    std::vector<draw_command> commands;
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> order;
+    // radix sort scratch
+    std::vector<std::uint64_t> keyScratch;
+    std::vector<std::uint32_t> orderScratch;
+
+    std::unordered_map<GLuint, std::uint32_t> programIds;
+    std::unordered_map<std::uint64_t, std::uint32_t> materialIds;
+    std::unordered_map<GLuint, std::uint32_t> vertexArrayIds;
+
+    // instance matrices go to the ring; the buffer is orphaned for them when there is none
+    ring_buffer *ring = nullptr;
+    GLuint instanceBuffer = 0;
+
+    // one list and its statistics per chunk of the range being executed; chunk i is [chunkBounds[i], chunkBounds[i + 1])
+    std::vector<command_list> lists;
+    std::vector<render_stats> listStats;
+    std::vector<std::size_t> chunkBounds;
+    std::size_t listCount = 0;
+    std::size_t maxLists = 0;
+
+    render_stats frameStats;
+
+    std::size_t record_range(std::size_t begin, std::size_t end);
+    // fills chunkBounds for the sorted positions [begin, end)
+    void partition(std::size_t begin, std::size_t end, std::size_t maxChunks);
+    // translates sorted positions [begin, end) into GL-free commands; state tracking starts over in every list
+    void record_chunk(std::size_t begin, std::size_t end, command_list &list, render_stats &stats) const;
+    // end of the run of commands starting at sorted position begin that can be drawn as instances of one call
+    std::size_t batch_end(std::size_t begin, std::size_t end) const;
+};
+
+
+#endif //CG_RENDER_QUEUE_H
@@ -0,0 +1,115 @@
+//
+// 持久映射的环形缓冲区：每帧的动态数据（uniform块、实例矩阵）从中分配，按帧用栅栏同步
+//
+
+#include "ring_buffer.h"
+#include "utility.h"
+
+#include <iostream>
+
+namespace {
+    // glBufferStorage is core in 4.4 and comes with GL_ARB_buffer_storage under the same name before that. glad is
+    // generated without extensions, so on a 4.3 context the entry point is fetched here
+    bool load_buffer_storage() {
+        if (GLAD_GL_VERSION_4_4 && glBufferStorage)
+            return true;
+        if (!utility::has_extension("GL_ARB_buffer_storage"))
+            return false;
+        if (!glBufferStorage)
+            glad_glBufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(utility::get_proc_address("glBufferStorage"));
+        return glBufferStorage != nullptr;
+    }
+}
+
+ring_buffer::ring_buffer(std::size_t bytesPerFrame, int framesInFlight) :
+    regionSize(bytesPerFrame), frames(framesInFlight > 0 ? framesInFlight : 1), fences(frames, nullptr) {
+    const auto size = static_cast<GLsizeiptr>(regionSize * frames);
+    glGenBuffers(1, &buffer);
+    // a target no other code binds to, so creating the buffer disturbs no state
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (load_buffer_storage()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        mapped = static_cast<unsigned char *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+        if (!mapped)
+            std::cout << "ERROR::RING_BUFFER:: persistent mapping failed" << std::endl;
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+ring_buffer::~ring_buffer() {
+    for (GLsync fence: fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    if (mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void ring_buffer::begin_frame() {
+    head = 0;
+    GLsync &fence = fences[frame];
+    if (!fence)
+        return;
+    // the region was last used frames ago; normally its fence has long been signalled
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        stallCount++;
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void ring_buffer::end_frame() {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % frames;
+}
+
+ring_allocation ring_buffer::allocate(std::size_t bytes, std::size_t alignment) {
+    ring_allocation allocation;
+    const std::size_t start = (head + alignment - 1) & ~(alignment - 1);
+    if (start + bytes > regionSize) {
+        if (!overflowReported)
+            std::cout << "ERROR::RING_BUFFER:: frame region of " << regionSize << " bytes is full" << std::endl;
+        overflowReported = true;
+        return allocation;
+    }
+    head = start + bytes;
+    allocation.buffer = buffer;
+    allocation.offset = static_cast<GLintptr>(regionSize * frame + start);
+    allocation.size = static_cast<GLsizeiptr>(bytes);
+    if (mapped) {
+        allocation.data = mapped + allocation.offset;
+    } else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                           GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return allocation;
+}
+
+void ring_buffer::commit(const ring_allocation &allocation) {
+    // coherent writes are visible to commands issued afterwards
+    if (mapped || !allocation.data)
+        return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+std::size_t ring_buffer::uniform_alignment() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return static_cast<std::size_t>(alignment > 0 ? alignment : 256);
+}
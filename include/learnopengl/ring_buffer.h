@@ -0,0 +1,63 @@
+//
+// 持久映射的环形缓冲区：每帧的动态数据（uniform块、实例矩阵）从中分配，按帧用栅栏同步
+//
+
+#ifndef CG_RING_BUFFER_H
+#define CG_RING_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+// a piece of the current frame's region
+struct ring_allocation {
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+    // where to write the data, nullptr if the frame's region is full
+    void *data = nullptr;
+};
+
+// One buffer split into a region per frame in flight. Frame n writes region n % frames; begin_frame() waits for
+// the fence end_frame() placed after the last use of that region, so writes never touch data the GPU may still
+// read, and the driver never has to synchronise implicitly.
+// With GL 4.4, or GL_ARB_buffer_storage which current 4.3 drivers have as well, the buffer is created with
+// glBufferStorage and mapped once, persistent and coherent. Contexts without either map each allocation with
+// GL_MAP_UNSYNCHRONIZED_BIT instead (the fences make that safe) and unmap it in commit().
+// The buffer can be bound to any target: uniform blocks, shader storage, vertex attributes.
+class ring_buffer {
+public:
+    explicit ring_buffer(std::size_t bytesPerFrame, int framesInFlight = 3);
+    ~ring_buffer();
+    ring_buffer(const ring_buffer &) = delete;
+    ring_buffer &operator=(const ring_buffer &) = delete;
+
+    void begin_frame();
+    void end_frame();
+
+    // alignment must be a power of two, e.g. uniform_alignment() for glBindBufferRange on GL_UNIFORM_BUFFER
+    ring_allocation allocate(std::size_t bytes, std::size_t alignment = 16);
+    // call after writing, before the GPU reads the allocation and before the next allocate
+    void commit(const ring_allocation &allocation);
+
+    static std::size_t uniform_alignment();
+    bool persistent() const { return mapped != nullptr; }
+    // frames that had to wait for the GPU to release their region
+    std::size_t stalls() const { return stallCount; }
+    GLuint id() const { return buffer; }
+
+private:
+    GLuint buffer = 0;
+    std::size_t regionSize;
+    int frames;
+    int frame = 0;
+    std::size_t head = 0;
+    // start of the persistent mapping, nullptr for the unsynchronised map fallback
+    unsigned char *mapped = nullptr;
+    std::vector<GLsync> fences;
+    std::size_t stallCount = 0;
+    bool overflowReported = false;
+};
+
+
+#endif //CG_RING_BUFFER_H
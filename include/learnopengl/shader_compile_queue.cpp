@@ -0,0 +1,93 @@
+//
+// 着色器异步编译队列：一次性提交所有程序，驱动并行编译，完成后再取用
+//
+
+#include "shader_compile_queue.h"
+#include "utility.h"
+
+// from GL_KHR_parallel_shader_compile; glad is generated without extensions
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+shader_compile_queue::shader_compile_queue() {
+    const bool khr = utility::has_extension("GL_KHR_parallel_shader_compile");
+    const bool arb = !khr && utility::has_extension("GL_ARB_parallel_shader_compile");
+    parallelCompile = khr || arb;
+    if (!parallelCompile)
+        return;
+    // let the driver use as many compiler threads as it likes
+    using max_threads_fn = void (APIENTRYP)(GLuint count);
+    auto maxThreads = reinterpret_cast<max_threads_fn>(
+        utility::get_proc_address(khr ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB"));
+    if (maxThreads)
+        maxThreads(0xFFFFFFFFu);
+}
+
+shader_compile_queue::~shader_compile_queue() {
+    for (auto &j: jobs) {
+        if (!j.shader && j.program.vertex != 0) {
+            glDeleteShader(j.program.vertex);
+            glDeleteShader(j.program.fragment);
+        }
+        gl_state::instance().forget_program(j.program.program);
+        glDeleteProgram(j.program.program);
+    }
+}
+
+shader_compile_queue::handle shader_compile_queue::submit(const std::string &vertexPath,
+                                                          const std::string &fragmentPath,
+                                                          const std::vector<std::string> &defines,
+                                                          std::function<void(const Shader &)> setup) {
+    job j;
+    j.program = Shader::startProgram(vertexPath.c_str(), fragmentPath.c_str(), defines);
+    j.setup = std::move(setup);
+    jobs.push_back(std::move(j));
+    // a program restored from the binary cache is already linked
+    if (jobs.back().program.vertex == 0)
+        finish(jobs.back());
+    return handle{jobs.size() - 1};
+}
+
+void shader_compile_queue::poll() {
+    std::size_t blocking = 0;
+    for (auto &j: jobs) {
+        if (j.shader)
+            continue;
+        if (parallelCompile) {
+            GLint done = GL_FALSE;
+            glGetProgramiv(j.program.program, GL_COMPLETION_STATUS_KHR, &done);
+            if (done)
+                finish(j);
+        } else if (blocking < blockingBudget) {
+            blocking++;
+            finish(j);
+        }
+    }
+}
+
+void shader_compile_queue::finish_all() {
+    for (auto &j: jobs) {
+        if (!j.shader)
+            finish(j);
+    }
+}
+
+const Shader *shader_compile_queue::get(handle h) const {
+    return h.index < jobs.size() ? jobs[h.index].shader.get() : nullptr;
+}
+
+std::size_t shader_compile_queue::pending() const {
+    std::size_t count = 0;
+    for (const auto &j: jobs) {
+        if (!j.shader)
+            count++;
+    }
+    return count;
+}
+
+void shader_compile_queue::finish(job &j) {
+    j.shader = std::make_unique<Shader>(j.program);
+    if (j.setup)
+        j.setup(*j.shader);
+}
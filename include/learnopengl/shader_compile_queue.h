@@ -0,0 +1,63 @@
+//
+// 着色器异步编译队列：一次性提交所有程序，驱动并行编译，完成后再取用
+//
+
+#ifndef CG_SHADER_COMPILE_QUEUE_H
+#define CG_SHADER_COMPILE_QUEUE_H
+
+#include <learnopengl/shader_m.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Programs are started as soon as they are submitted and only checked in poll(), so the driver can compile
+// them in the background. With GL_KHR_parallel_shader_compile (or the ARB version) poll() asks
+// GL_COMPLETION_STATUS_KHR and never blocks; without it poll() finishes a few programs per call, which blocks
+// for those only. Until get() returns a program the caller draws with a fallback of its own.
+class shader_compile_queue {
+public:
+    struct handle {
+        std::size_t index;
+    };
+
+    shader_compile_queue();
+    ~shader_compile_queue();
+    shader_compile_queue(const shader_compile_queue &) = delete;
+    shader_compile_queue &operator=(const shader_compile_queue &) = delete;
+
+    // setup is called once the program is linked, e.g. to bind uniform blocks and sampler units
+    handle submit(const std::string &vertexPath, const std::string &fragmentPath,
+                  const std::vector<std::string> &defines = {}, std::function<void(const Shader &)> setup = nullptr);
+    // finishes the programs the driver is done with; call once per frame
+    void poll();
+    // blocks until every submitted program is finished
+    void finish_all();
+
+    // nullptr while the program is still compiling
+    const Shader *get(handle h) const;
+    bool ready(handle h) const { return get(h) != nullptr; }
+    std::size_t pending() const;
+    bool parallel() const { return parallelCompile; }
+
+    // programs finished per poll() when the driver can't report completion
+    void set_blocking_budget(std::size_t programs) { blockingBudget = programs; }
+
+private:
+    struct job {
+        pending_program program;
+        std::function<void(const Shader &)> setup;
+        std::unique_ptr<Shader> shader;
+    };
+
+    void finish(job &j);
+
+    std::vector<job> jobs;
+    bool parallelCompile = false;
+    std::size_t blockingBudget = 1;
+};
+
+
+#endif //CG_SHADER_COMPILE_QUEUE_H
@@ -4,138 +4,341 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/shader_preprocessor.h>
+
+// 32 bit FNV-1a hash of a uniform name; constexpr so names written as literals are hashed by the compiler
+constexpr std::uint32_t uniformHash(const char* name, std::size_t length)
+{
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// handle of a uniform: "material.shininess"_u
+struct uniform_name
+{
+    std::uint32_t hash;
+};
+
+constexpr uniform_name operator""_u(const char* name, std::size_t length)
+{
+    return uniform_name{uniformHash(name, length)};
+}
+
+// a program whose compile and link have been issued but not checked yet
+struct pending_program
+{
+    GLuint program = 0;
+    // 0 when the program was restored from the binary cache; a compute program has only the compute stage
+    GLuint vertex = 0;
+    GLuint fragment = 0;
+    GLuint compute = 0;
+    std::uint64_t cacheKey = 0;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // name of the program's GPU scope in the profiler, interned once here instead of for every draw group
+    const char* profileName;
+    // constructor generates the shader on the fly, or restores it from the program binary cache
+    // both stages go through preprocess_shader: #include is expanded and the defines are inserted after #version
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {})
+        : Shader(startProgram(vertexPath, fragmentPath, defines))
+    {
+    }
+    // finishes a program started with startProgram; blocks if the driver is still compiling it
+    // ------------------------------------------------------------------------
+    explicit Shader(const pending_program& pending)
+    {
+        ID = pending.program;
+        if (pending.vertex != 0 || pending.compute != 0)
+        {
+            if (pending.vertex != 0)
+            {
+                checkCompileErrors(pending.vertex, "VERTEX");
+                checkCompileErrors(pending.fragment, "FRAGMENT");
+            }
+            else
+            {
+                checkCompileErrors(pending.compute, "COMPUTE");
+            }
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDeleteShader(pending.vertex);
+            glDeleteShader(pending.fragment);
+            glDeleteShader(pending.compute);
+            GLint success = 0;
+            glGetProgramiv(ID, GL_LINK_STATUS, &success);
+            if (success)
+                program_cache::instance().store(pending.cacheKey, ID);
+        }
+        profileName = profiler::instance().intern("program " + std::to_string(ID));
+        reflectUniforms();
+    }
+    // reads the sources and either restores the program from the binary cache or issues compile and link
+    // without asking for the result, so the driver can work on several programs at once
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    static pending_program startProgram(const char* vertexPath, const char* fragmentPath,
+                                        const std::vector<std::string>& defines = {})
     {
-        // 1. retrieve the vertex/fragment source code from filePath
+        // 1. retrieve the vertex/fragment source code from filePath, with includes and defines expanded
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            vertexCode = preprocess_shader(vertexPath, defines);
+            fragmentCode = preprocess_shader(fragmentPath, defines);
         }
-        catch (std::ifstream::failure& e)
+        catch (const std::string& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            std::cout << e << std::endl;
         }
+        // 2. a binary of exactly these sources linked by this driver may already exist
+        pending_program pending;
+        auto &cache = program_cache::instance();
+        pending.cacheKey = cache.key(vertexCode, fragmentCode);
+        pending.program = cache.load(pending.cacheKey);
+        if (pending.program != 0)
+            return pending;
+
+        // 3. compile shaders
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
         // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(pending.vertex);
         // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(pending.fragment);
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+        pending.program = glCreateProgram();
+        glAttachShader(pending.program, pending.vertex);
+        glAttachShader(pending.program, pending.fragment);
+        if (cache.supported())
+            glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(pending.program);
+        return pending;
+    }
+    // compute program (GL 4.3), preprocessed and cached like the others; blocks until it is linked
+    // ------------------------------------------------------------------------
+    static Shader compute(const char* computePath, const std::vector<std::string>& defines = {})
+    {
+        std::string computeCode;
+        try
+        {
+            computeCode = preprocess_shader(computePath, defines);
+        }
+        catch (const std::string& e)
+        {
+            std::cout << e << std::endl;
+        }
+        pending_program pending;
+        auto &cache = program_cache::instance();
+        pending.cacheKey = cache.key(computeCode, "COMPUTE");
+        pending.program = cache.load(pending.cacheKey);
+        if (pending.program == 0)
+        {
+            const char* cShaderCode = computeCode.c_str();
+            pending.compute = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(pending.compute, 1, &cShaderCode, NULL);
+            glCompileShader(pending.compute);
+            pending.program = glCreateProgram();
+            glAttachShader(pending.program, pending.compute);
+            if (cache.supported())
+                glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glLinkProgram(pending.program);
+        }
+        return Shader(pending);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     {
-        glUseProgram(ID);
+        gl_state::instance().use_program(ID);
+    }
+    // connects a uniform block of the program to a binding point; blocks the program doesn't declare are ignored
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, GLuint binding) const
+    {
+        const GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // location of an active uniform, -1 (ignored by glUniform*) if the program doesn't use it
+    // ------------------------------------------------------------------------
+    GLint location(uniform_name name) const
+    {
+        auto it = uniformLocations.find(name.hash);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    GLint location(const std::string &name) const
+    {
+        return location(uniform_name{uniformHash(name.data(), name.size())});
     }
     // utility uniform functions
+    // the std::string overloads hash at run time, the uniform_name ones take a pre-hashed "name"_u;
+    // neither asks the driver for the location. Values the program already holds are not sent again,
+    // so the program has to be in use.
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    template<class Name>
+    void setBool(const Name &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setInt(name, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    template<class Name>
+    void setInt(const Name &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &value, sizeof(value)))
+            glUniform1i(loc, value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    template<class Name>
+    void setFloat(const Name &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &value, sizeof(value)))
+            glUniform1f(loc, value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    template<class Name>
+    void setVec2(const Name &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &value[0], sizeof(value)))
+            glUniform2fv(loc, 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    template<class Name>
+    void setVec2(const Name &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(name, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    template<class Name>
+    void setVec3(const Name &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &value[0], sizeof(value)))
+            glUniform3fv(loc, 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    template<class Name>
+    void setVec3(const Name &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(name, glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    template<class Name>
+    void setVec4(const Name &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &value[0], sizeof(value)))
+            glUniform4fv(loc, 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    template<class Name>
+    void setVec4(const Name &name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(name, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    template<class Name>
+    void setIVec4(const Name &name, const glm::ivec4 &value) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &value[0], sizeof(value)))
+            glUniform4iv(loc, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    template<class Name>
+    void setMat2(const Name &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &mat[0][0], sizeof(mat)))
+            glUniformMatrix2fv(loc, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    template<class Name>
+    void setMat3(const Name &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &mat[0][0], sizeof(mat)))
+            glUniformMatrix3fv(loc, 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    template<class Name>
+    void setMat4(const Name &name, const glm::mat4 &mat) const
+    {
+        const GLint loc = location(name);
+        if (uniformChanged(loc, &mat[0][0], sizeof(mat)))
+            glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // active uniform locations by name hash, filled once after linking
+    std::unordered_map<std::uint32_t, GLint> uniformLocations;
+
+    bool uniformChanged(GLint loc, const void* data, std::size_t bytes) const
+    {
+        return gl_state::instance().uniform_changed(ID, loc, data, bytes);
+    }
+
+    // asks the driver for every active uniform once. Arrays of basic types are registered under
+    // "name", "name[0]", "name[1]", ...; members of struct arrays are reported one by one by GL.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(static_cast<std::size_t>(maxLength > 0 ? maxLength : 1), '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+            std::string uniform = name.substr(0, static_cast<std::size_t>(length));
+            const GLint base = glGetUniformLocation(ID, uniform.c_str());
+            if (base < 0)
+                continue; // uniforms inside uniform blocks have no location
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            {
+                const std::string array = uniform.substr(0, uniform.size() - 3);
+                registerUniform(array, base);
+                for (GLint element = 0; element < size; element++)
+                    registerUniform(array + "[" + std::to_string(element) + "]", base + element);
+            }
+            else
+            {
+                registerUniform(uniform, base);
+            }
+        }
+    }
+    void registerUniform(const std::string &name, GLint location)
+    {
+        auto inserted = uniformLocations.emplace(uniformHash(name.data(), name.size()), location);
+        if (!inserted.second && inserted.first->second != location)
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << name << std::endl;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,58 @@
+//
+// 着色器预处理：#include和宏定义
+//
+
+#include "shader_preprocessor.h"
+
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace {
+    std::string directory_of(const std::string &path) {
+        const std::size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    void expand(const std::string &path, std::set<std::string> &included, std::string &out) {
+        if (!included.insert(path).second)
+            return;
+        std::ifstream file(path);
+        if (!file) {
+            throw std::string("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: ") + path;
+        }
+        const std::string directory = directory_of(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            const std::size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+                const std::size_t open = line.find('"', start);
+                const std::size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close == std::string::npos) {
+                    throw std::string("ERROR::SHADER::BAD_INCLUDE: ") + path + ": " + line;
+                }
+                expand(directory + line.substr(open + 1, close - open - 1), included, out);
+                continue;
+            }
+            out += line;
+            out += '\n';
+        }
+    }
+}
+
+std::string preprocess_shader(const std::string &path, const std::vector<std::string> &defines) {
+    std::set<std::string> included;
+    std::string source;
+    expand(path, included, source);
+    if (defines.empty())
+        return source;
+
+    std::string lines;
+    for (const auto &define: defines)
+        lines += "#define " + define + "\n";
+    // #version has to stay the first statement
+    const std::size_t version = source.find("#version");
+    const std::size_t end_of_version = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    const std::size_t insert_at = end_of_version == std::string::npos ? 0 : end_of_version + 1;
+    return source.substr(0, insert_at) + lines + source.substr(insert_at);
+}
@@ -0,0 +1,17 @@
+//
+// 着色器预处理：#include和宏定义
+//
+
+#ifndef CG_SHADER_PREPROCESSOR_H
+#define CG_SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+// Reads a shader file and expands every #include "file" line, paths relative to the including file. A file is
+// only included once per stage, so shared headers need no guards. The defines are inserted as "#define <define>"
+// lines after #version. Throws a std::string if a file can't be read.
+std::string preprocess_shader(const std::string &path, const std::vector<std::string> &defines = {});
+
+
+#endif //CG_SHADER_PREPROCESSOR_H
@@ -0,0 +1,63 @@
+//
+// 着色器变体：按材质和场景特性生成并缓存专用的程序
+//
+
+#include "shader_variants.h"
+
+#include <algorithm>
+
+std::uint32_t shader_features::key() const {
+    std::uint32_t key = static_cast<std::uint32_t>(std::min(std::max(point_lights, 0), 255));
+    key |= (dir_light ? 1u : 0u) << 8;
+    key |= (spot_light ? 1u : 0u) << 9;
+    key |= (specular_map ? 1u : 0u) << 10;
+    key |= (specular_map && packed_specular ? 1u : 0u) << 11;
+    key |= (normal_map ? 1u : 0u) << 12;
+    key |= (instancing ? 1u : 0u) << 13;
+    key |= (clustered ? 1u : 0u) << 14;
+    key |= (object_lights ? 1u : 0u) << 15;
+    return key;
+}
+
+std::vector<std::string> shader_features::defines() const {
+    std::vector<std::string> defines;
+    defines.push_back("NR_POINT_LIGHTS " + std::to_string(point_lights));
+    if (dir_light)
+        defines.emplace_back("HAS_DIR_LIGHT");
+    if (spot_light)
+        defines.emplace_back("HAS_SPOT_LIGHT");
+    if (specular_map)
+        defines.emplace_back("HAS_SPECULAR_MAP");
+    if (specular_map && packed_specular)
+        defines.emplace_back("PACKED_SPECULAR");
+    if (normal_map)
+        defines.emplace_back("HAS_NORMAL_MAP");
+    if (instancing)
+        defines.emplace_back("INSTANCING");
+    if (clustered)
+        defines.emplace_back("CLUSTERED_LIGHTS");
+    if (object_lights)
+        defines.emplace_back("OBJECT_LIGHTS");
+    return defines;
+}
+
+shader_library::shader_library(shader_compile_queue &queue, std::string vertexPath, std::string fragmentPath,
+                               std::function<void(const Shader &)> setup) :
+    queue(queue), vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)), setup(std::move(setup)) {
+}
+
+void shader_library::prewarm(const shader_features &features) {
+    submit(features);
+}
+
+const Shader *shader_library::get(const shader_features &features) {
+    return queue.get(submit(features));
+}
+
+shader_compile_queue::handle shader_library::submit(const shader_features &features) {
+    const std::uint32_t key = features.key();
+    auto it = variants.find(key);
+    if (it == variants.end())
+        it = variants.emplace(key, queue.submit(vertexPath, fragmentPath, features.defines(), setup)).first;
+    return it->second;
+}
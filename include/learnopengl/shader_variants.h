@@ -0,0 +1,63 @@
+//
+// 着色器变体：按材质和场景特性生成并缓存专用的程序
+//
+
+#ifndef CG_SHADER_VARIANTS_H
+#define CG_SHADER_VARIANTS_H
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/shader_compile_queue.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The features a program is specialised for. Everything that is off is compiled out, so a material without a
+// specular map or a scene without a spotlight doesn't pay for them.
+struct shader_features {
+    // lights the scene actually uses; clustered point lights come from light_clusters instead of the Lights block
+    int point_lights = 0;
+    bool clustered = false;
+    // point lights and spotlight come from a per-draw list (object_lights) instead of NR_POINT_LIGHTS
+    bool object_lights = false;
+    bool dir_light = false;
+    bool spot_light = false;
+    // maps the material has
+    bool specular_map = false;
+    bool packed_specular = false;
+    bool normal_map = false;
+    // model matrices come from a per-instance attribute
+    bool instancing = false;
+
+    std::uint32_t key() const;
+    std::vector<std::string> defines() const;
+};
+
+// All permutations of one vertex/fragment pair. A variant is submitted to the compile queue the first time it is
+// asked for (or up front with prewarm) and get() returns nullptr until the queue has finished it.
+class shader_library {
+public:
+    // setup is called once for every new variant, e.g. to bind uniform blocks and sampler units
+    shader_library(shader_compile_queue &queue, std::string vertexPath, std::string fragmentPath,
+                   std::function<void(const Shader &)> setup = nullptr);
+    shader_library(const shader_library &) = delete;
+    shader_library &operator=(const shader_library &) = delete;
+
+    void prewarm(const shader_features &features);
+    const Shader *get(const shader_features &features);
+    std::size_t size() const { return variants.size(); }
+
+private:
+    shader_compile_queue::handle submit(const shader_features &features);
+
+    shader_compile_queue &queue;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::function<void(const Shader &)> setup;
+    std::unordered_map<std::uint32_t, shader_compile_queue::handle> variants;
+};
+
+
+#endif //CG_SHADER_VARIANTS_H
@@ -0,0 +1,18 @@
+//
+// 选择可用的SIMD指令集
+//
+
+#ifndef CG_SIMD_H
+#define CG_SIMD_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CG_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define CG_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+
+#endif //CG_SIMD_H
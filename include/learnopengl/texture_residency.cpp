@@ -0,0 +1,105 @@
+//
+// 纹理显存预算：按最近最少使用淘汰，被再次引用时异步重新加载
+//
+
+#include "texture_residency.h"
+#include "gl_state.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+    // an evicted texture keeps a single RGBA8 texel
+    constexpr std::size_t PLACEHOLDER_BYTES = 4;
+}
+
+texture_residency &texture_residency::instance() {
+    static texture_residency residency;
+    return residency;
+}
+
+std::size_t texture_residency::gpu_bytes(const mip_chain &chain) {
+    const std::size_t bytes = chain.byte_size();
+    return chain.channels == 3 ? bytes / 3 * 4 : bytes;
+}
+
+void texture_residency::track(unsigned int id, const mip_chain &chain) {
+    if (chain.source.filename.empty() || entries.count(id) != 0)
+        return;
+    lru.push_front(id);
+    entry e{chain.source, gpu_bytes(chain), chain.levels.size(), true, frame, {}, lru.begin()};
+    resident += e.bytes;
+    entries.emplace(id, std::move(e));
+}
+
+void texture_residency::release(unsigned int id) {
+    auto it = entries.find(id);
+    if (it != entries.end()) {
+        resident -= it->second.bytes;
+        lru.erase(it->second.lru_position);
+        // a pending reload is left to finish on its own, the future's result is simply dropped
+        entries.erase(it);
+    }
+    gl_state::instance().forget_texture(id);
+    glDeleteTextures(1, &id);
+}
+
+void texture_residency::touch(unsigned int id) {
+    auto it = entries.find(id);
+    if (it == entries.end())
+        return;
+    entry &e = it->second;
+    e.last_used = frame;
+    lru.splice(lru.begin(), lru, e.lru_position);
+    if (!e.resident && !e.reload.valid()) {
+        e.reload = load_mip_chain_async(e.source);
+    }
+}
+
+void texture_residency::evict(unsigned int id, entry &e) {
+    // respecifying level 0 as a single texel and every other level as empty frees the old storage but keeps the
+    // name valid for the meshes
+    const unsigned char placeholder[4] = {128, 128, 128, 255};
+    gl_state::instance().bind_texture(0, GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    for (std::size_t level = 1; level < e.levels; level++)
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    e.resident = false;
+    resident -= e.bytes - PLACEHOLDER_BYTES;
+    e.bytes = PLACEHOLDER_BYTES;
+    e.levels = 1;
+    evicted++;
+}
+
+void texture_residency::update() {
+    for (auto &item: entries) {
+        entry &e = item.second;
+        if (e.reload.valid() && e.reload.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            try {
+                const mip_chain chain = e.reload.get();
+                upload_mip_chain(item.first, chain);
+                resident -= e.bytes;
+                e.bytes = gpu_bytes(chain);
+                e.levels = chain.levels.size();
+                e.resident = true;
+                resident += e.bytes;
+            } catch (const std::string &error) {
+                // keep the placeholder, the next bind tries again
+                std::cout << error << std::endl;
+            }
+        }
+    }
+
+    // walk from the least recently used end, never evicting what the current frame has bound
+    for (auto it = lru.rbegin(); it != lru.rend() && resident > budget; ++it) {
+        entry &e = entries.at(*it);
+        if (e.last_used == frame)
+            break;
+        if (e.resident)
+            evict(*it, e);
+    }
+    frame++;
+}
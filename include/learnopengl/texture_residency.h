@@ -0,0 +1,65 @@
+//
+// 纹理显存预算：按最近最少使用淘汰，被再次引用时异步重新加载
+//
+
+#ifndef CG_TEXTURE_RESIDENCY_H
+#define CG_TEXTURE_RESIDENCY_H
+
+#include "mipmap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Tracks the memory of every texture loaded from a file. When the total goes over the budget the least recently
+// bound textures are replaced by a 1x1 placeholder (the texture name stays valid) and reloaded in the background
+// the next time they are bound. All functions must be called on the thread that owns the GL context.
+class texture_residency {
+public:
+    static texture_residency &instance();
+
+    void set_budget(std::size_t bytes) { budget = bytes; }
+    std::size_t get_budget() const { return budget; }
+    std::size_t resident_bytes() const { return resident; }
+    std::size_t evicted_count() const { return evicted; }
+
+    // starts tracking a texture whose storage was uploaded from the given chain
+    void track(unsigned int id, const mip_chain &chain);
+    // stops tracking the texture and deletes it
+    void release(unsigned int id);
+    // marks the texture as used by the current frame, reloading it if it was evicted
+    void touch(unsigned int id);
+    // once per frame: uploads finished reloads and evicts textures until the budget is met
+    void update();
+
+    // estimated size of the chain once uploaded (drivers pad RGB to RGBA)
+    static std::size_t gpu_bytes(const mip_chain &chain);
+
+private:
+    struct entry {
+        mip_source source;
+        // what the texture holds now: the whole chain, or the placeholder once evicted
+        std::size_t bytes;
+        std::size_t levels;
+        bool resident;
+        std::uint64_t last_used;
+        std::future<mip_chain> reload;
+        std::list<unsigned int>::iterator lru_position;
+    };
+
+    std::unordered_map<unsigned int, entry> entries;
+    // most recently used at the front
+    std::list<unsigned int> lru;
+    std::size_t budget = 256u << 20;
+    std::size_t resident = 0;
+    std::size_t evicted = 0;
+    std::uint64_t frame = 0;
+
+    void evict(unsigned int id, entry &e);
+};
+
+
+#endif //CG_TEXTURE_RESIDENCY_H
@@ -0,0 +1,95 @@
+//
+// 简单的工作线程池
+//
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+thread_pool::thread_pool(unsigned int threads) {
+    threads = std::max(1u, threads);
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; i++) {
+        workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+void thread_pool::worker_loop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
+
+void thread_pool::parallel_for(std::size_t begin, std::size_t end, const std::function<void(std::size_t)> &fn) {
+    if (begin >= end)
+        return;
+    const std::size_t count = end - begin;
+    if (count == 1) {
+        fn(begin);
+        return;
+    }
+    // the state is shared with the helper jobs: a helper that only starts after the loop has finished
+    // finds no work left and must not touch the caller's stack.
+    struct loop_state {
+        std::function<void(std::size_t)> fn;
+        std::size_t begin, end;
+        std::atomic<std::size_t> next;
+        std::atomic<std::size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<loop_state>();
+    state->fn = fn;
+    state->begin = begin;
+    state->end = end;
+    state->next = begin;
+    auto run = [state] {
+        std::size_t i;
+        while ((i = state->next.fetch_add(1)) < state->end) {
+            state->fn(i);
+            if (state->done.fetch_add(1) + 1 == state->end - state->begin) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+    const std::size_t helpers = std::min<std::size_t>(size(), count - 1);
+    for (std::size_t i = 0; i < helpers; i++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace(run);
+        }
+        wake.notify_one();
+    }
+    run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state, count] { return state->done.load() == count; });
+}
+
+thread_pool &thread_pool::shared() {
+    // leave one core to the simulation thread and one to the render thread; the render thread also takes part in
+    // the parallel_for calls it makes (clustering, occlusion, command recording). At least one worker.
+    static thread_pool pool(std::max(3u, std::thread::hardware_concurrency()) - 2);
+    return pool;
+}
@@ -0,0 +1,58 @@
+//
+// 简单的工作线程池
+//
+
+#ifndef CG_THREAD_POOL_H
+#define CG_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+    explicit thread_pool(unsigned int threads = std::thread::hardware_concurrency());
+    ~thread_pool();
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    // queue a job and get a future for its result
+    template<class F>
+    auto submit(F &&f) -> std::future<decltype(f())> {
+        using result = decltype(f());
+        auto task = std::make_shared<std::packaged_task<result()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace([task] { (*task)(); });
+        }
+        wake.notify_one();
+        return future;
+    }
+
+    // run fn(i) for every i in [begin, end). The calling thread takes part in the work, so it is safe to call
+    // from inside a job of the same pool.
+    void parallel_for(std::size_t begin, std::size_t end, const std::function<void(std::size_t)> &fn);
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // pool shared by the loaders and the per-frame systems
+    static thread_pool &shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    void worker_loop();
+};
+
+
+#endif //CG_THREAD_POOL_H
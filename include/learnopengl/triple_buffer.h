@@ -0,0 +1,56 @@
+//
+// 无锁三缓冲：一个线程发布数据，另一个线程总是读到最新发布的一份
+//
+
+#ifndef CG_TRIPLE_BUFFER_H
+#define CG_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// single producer, single consumer. The writer fills back() and publishes it, the reader acquires the latest
+// published slot and reads front(). The slots are only exchanged through one atomic index, so neither side ever
+// waits for the other: a writer that is faster than the reader overwrites snapshots the reader never saw, a reader
+// that is faster than the writer keeps the snapshot it already has.
+template<class T>
+class triple_buffer {
+public:
+    triple_buffer() = default;
+    explicit triple_buffer(const T &initial) : slots{initial, initial, initial} {}
+    triple_buffer(const triple_buffer &) = delete;
+    triple_buffer &operator=(const triple_buffer &) = delete;
+
+    // writer side: the slot being filled, owned by the writer until publish()
+    T &back() { return slots[backIndex]; }
+
+    // hand back() to the reader and take the slot the reader isn't using as the new back()
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader side: switch front() to the latest published slot. Returns false, and keeps front(), when nothing
+    // was published since the last call.
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // the slot the reader owns, it isn't touched by the writer until the next acquire()
+    const T &front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr unsigned int INDEX = 3;
+    static constexpr unsigned int FRESH = 4;
+
+    T slots[3];
+    // owned by the writer and the reader respectively
+    unsigned int backIndex = 0;
+    unsigned int frontIndex = 1;
+    // the slot in between, FRESH while it holds data the reader hasn't acquired. On its own cache line so that
+    // the exchanges don't contend with the slots.
+    alignas(64) std::atomic<unsigned int> middle{2};
+};
+
+
+#endif //CG_TRIPLE_BUFFER_H
@@ -0,0 +1,86 @@
+//
+// 着色器共享的uniform块（std140布局）
+//
+
+#ifndef CG_UNIFORM_BLOCKS_H
+#define CG_UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <learnopengl/shader_m.h>
+
+// binding points, shared by every program
+constexpr GLuint CAMERA_BLOCK_BINDING = 0;
+constexpr GLuint LIGHTS_BLOCK_BINDING = 1;
+
+// size of the pointLights array in the Lights block (MAX_POINT_LIGHTS in lighting.glsl)
+constexpr int MAX_POINT_LIGHTS = 4;
+
+// the C++ mirrors of the GLSL blocks. Scalars are placed in the padding std140 leaves after each vec3,
+// the static_asserts below check the offsets against the rules.
+
+// layout (std140) uniform Camera
+struct camera_block {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float padding;
+};
+
+struct dir_light_std140 {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+struct point_light_std140 {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct spot_light_std140 {
+    glm::vec3 position;
+    float cutOff;
+    glm::vec3 direction;
+    float outerCutOff;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+// layout (std140) uniform Lights
+struct lights_block {
+    dir_light_std140 dirLight;
+    point_light_std140 pointLights[MAX_POINT_LIGHTS];
+    spot_light_std140 spotLight;
+};
+
+static_assert(sizeof(camera_block) == 144, "Camera block doesn't match std140");
+static_assert(sizeof(dir_light_std140) == 64, "DirLight doesn't match std140");
+static_assert(sizeof(point_light_std140) == 64, "PointLight doesn't match std140");
+static_assert(sizeof(spot_light_std140) == 80, "SpotLight doesn't match std140");
+static_assert(offsetof(lights_block, pointLights) == 64, "Lights block doesn't match std140");
+static_assert(offsetof(lights_block, spotLight) == 64 + 64 * MAX_POINT_LIGHTS, "Lights block doesn't match std140");
+
+// connects the blocks a program declares to the shared binding points
+inline void bindFrameBlocks(const Shader &shader) {
+    shader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    shader.bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+}
+
+#endif //CG_UNIFORM_BLOCKS_H
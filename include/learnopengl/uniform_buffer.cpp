@@ -0,0 +1,64 @@
+//
+// 一个缓冲区中存放多个uniform块，每帧只写一次
+//
+
+#include "uniform_buffer.h"
+
+#include <cstring>
+
+uniform_buffer::uniform_buffer(std::initializer_list<std::pair<GLuint, std::size_t>> blocks) : bindings(blocks) {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const auto align = static_cast<std::size_t>(alignment > 0 ? alignment : 256);
+
+    std::size_t size = 0;
+    for (const auto &block: blocks) {
+        offsets.push_back(size);
+        size += (block.second + align - 1) / align * align;
+    }
+    staging.assign(size, 0);
+
+    glGenBuffers(1, &id);
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    std::size_t i = 0;
+    for (const auto &block: blocks) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, block.first, id, static_cast<GLintptr>(offsets[i++]),
+                          static_cast<GLsizeiptr>(block.second));
+    }
+}
+
+uniform_buffer::~uniform_buffer() {
+    glDeleteBuffers(1, &id);
+}
+
+void uniform_buffer::upload() const {
+    const auto size = static_cast<GLsizeiptr>(staging.size());
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, staging.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void uniform_buffer::upload(ring_buffer &ring) const {
+    const ring_allocation allocation = ring.allocate(staging.size(), ring_buffer::uniform_alignment());
+    if (!allocation.data) {
+        // the ring is full this frame; the own buffer is still correct, just synchronised by the driver
+        upload();
+        for (std::size_t i = 0; i < bindings.size(); i++) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, bindings[i].first, id, static_cast<GLintptr>(offsets[i]),
+                              static_cast<GLsizeiptr>(bindings[i].second));
+        }
+        return;
+    }
+    std::memcpy(allocation.data, staging.data(), staging.size());
+    ring.commit(allocation);
+    // offsets are multiples of the alignment, so every block stays aligned
+    for (std::size_t i = 0; i < bindings.size(); i++) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, bindings[i].first, allocation.buffer,
+                          allocation.offset + static_cast<GLintptr>(offsets[i]),
+                          static_cast<GLsizeiptr>(bindings[i].second));
+    }
+}
@@ -0,0 +1,43 @@
+//
+// 一个缓冲区中存放多个uniform块，每帧只写一次
+//
+
+#ifndef CG_UNIFORM_BUFFER_H
+#define CG_UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <learnopengl/ring_buffer.h>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// Several uniform blocks packed into one buffer object, each bound to its own binding point. The blocks are
+// edited in a CPU copy and sent with a single write per upload().
+class uniform_buffer {
+public:
+    // (binding point, block size) pairs
+    explicit uniform_buffer(std::initializer_list<std::pair<GLuint, std::size_t>> blocks);
+    ~uniform_buffer();
+    uniform_buffer(const uniform_buffer &) = delete;
+    uniform_buffer &operator=(const uniform_buffer &) = delete;
+
+    template<class T>
+    T &block(std::size_t index) {
+        return *reinterpret_cast<T *>(staging.data() + offsets[index]);
+    }
+
+    // orphans the old storage so the write never waits for draws still reading the previous frame
+    void upload() const;
+    // copies the blocks into the frame's region of the ring and binds them there instead
+    void upload(ring_buffer &ring) const;
+
+private:
+    GLuint id = 0;
+    std::vector<unsigned char> staging;
+    std::vector<std::size_t> offsets;
+    std::vector<std::pair<GLuint, std::size_t>> bindings;
+};
+
+
+#endif //CG_UNIFORM_BUFFER_H
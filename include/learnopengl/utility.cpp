@@ -34,9 +34,8 @@ utility::creat_window(const int width, const int height, const std::string &titl
     // 让GLFW捕捉鼠标动作
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     // glad加载所有OpenGL函数指针
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+    if (!load_gl([](const char *name) { return reinterpret_cast<void *>(glfwGetProcAddress(name)); })) {
         throw "Failed to initialize GLAD";
     }
     return window;
 }
-
@@ -18,6 +18,20 @@ public:
     static window* creat_window(int width, int height, const std::string &title, bool make_it_context = true,
                                 void (*mouse_callback)(window *, double, double) = nullptr,
                                 void(*scroll_callback)(window *, double, double) = nullptr);
+
+    // loads the GL functions of the current context with glad and remembers the loader for get_proc_address()
+    using proc_loader = void *(*)(const char *);
+    static bool load_gl(proc_loader loader);
+    // an extension function glad wasn't generated with, nullptr if the driver doesn't have it
+    static void *get_proc_address(const char *name);
+    // whether the current context has the extension
+    static bool has_extension(const char *name);
+
+    // writes the lower left width x height pixels of the default framebuffer as a binary PPM
+    static bool save_framebuffer(const std::string &path, int width, int height);
+
+private:
+    static proc_loader loader;
 };
 
 
@@ -0,0 +1,49 @@
+//
+// utility里只用OpenGL的部分：函数加载、扩展查询和读回帧缓冲，不用链接GLFW
+//
+
+#include "utility.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+utility::proc_loader utility::loader = nullptr;
+
+bool utility::load_gl(proc_loader procLoader) {
+    loader = procLoader;
+    return gladLoadGLLoader(procLoader) != 0;
+}
+
+void *utility::get_proc_address(const char *name) {
+    return loader ? loader(name) : nullptr;
+}
+
+bool utility::has_extension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const auto *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool utility::save_framebuffer(const std::string &path, int width, int height) {
+    std::vector<unsigned char> pixels(static_cast<std::size_t>(width) * height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file << "P6\n" << width << ' ' << height << "\n255\n";
+    // OpenGL rows start at the bottom, PPM rows at the top
+    const std::size_t row = static_cast<std::size_t>(width) * 3;
+    for (int y = height - 1; y >= 0; y--)
+        file.write(reinterpret_cast<const char *>(pixels.data() + row * y), static_cast<std::streamsize>(row));
+    return static_cast<bool>(file);
+}
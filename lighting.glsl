@@ -0,0 +1,114 @@
+// 光源结构体按std140排列：标量放在vec3后面的空隙中，与uniform_blocks.h中的C++结构体一致
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+// 块的大小在所有程序中必须一致，变体只改变NR_POINT_LIGHTS（实际计算的数量）
+#define MAX_POINT_LIGHTS 4
+
+layout (std140) uniform Lights
+{
+    DirLight dirLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
+// 一个片段的材质属性，每个片段只采样一次贴图
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float specularMask;
+    float shininess;
+};
+
+// 当使用平行光时计算颜色
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // 漫反射着色
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // 反射着色
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    // 合并结果
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specularMask;
+    return (ambient + diffuse + specular);
+}
+
+// 当使用点光源时计算颜色。
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    // 漫反射着色
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // 反射着色
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    // 衰减
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // 合并结果
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specularMask;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+// 当使用聚光灯时计算颜色。
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    // 漫反射着色
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    //  反射着色
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    // 衰减
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // 聚光灯强度
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // 合并结果
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specularMask;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
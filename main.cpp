@@ -10,47 +10,335 @@
 #include <learnopengl/vertices.h>
 #include <learnopengl/utility.h>
 #include <learnopengl/model.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/texture_residency.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/ring_buffer.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/shader_compile_queue.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/light_assignment.h>
+#include <learnopengl/g_buffer.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/material.h>
+#include <learnopengl/frustum_culling.h>
+#include <learnopengl/occlusion_culling.h>
+#include <learnopengl/gpu_culling.h>
+#include <learnopengl/dynamic_resolution.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/triple_buffer.h>
+#include <learnopengl/camera_path.h>
+#ifdef CG_HEADLESS
+#include <learnopengl/headless.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 // 窗口尺寸设置
 const unsigned int SCR_WIDTH = 960;
 const unsigned int SCR_HEIGHT = 720;
 
+// 镜面反射贴图打包进漫反射贴图的alpha通道（一个采样器），否则单独存为GL_R8
+constexpr bool PACK_MATERIAL_MAPS = true;
+
+// 投影的近平面和远平面，分簇光照的深度切片也按这个范围划分
+constexpr float Z_NEAR = 0.1f;
+constexpr float Z_FAR = 100.0f;
+
+// 分簇光照演示用的动态点光源数量
+constexpr int DEMO_LIGHTS = 1024;
+
+// GPU驱动剔除演示中额外的随机箱子数量
+constexpr int GPU_DEMO_BOXES = 20000;
+
+// 动态分辨率：场景每帧的目标GPU时间（毫秒），以及每个轴的最小和最大缩放比例
+constexpr float DYNAMIC_RESOLUTION_TARGET_MS = 1000.0f / 60.0f;
+constexpr float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+constexpr float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+
+// 模拟线程没有输入事件时的最长等待时间（秒），即每秒至少模拟240次
+constexpr double SIMULATION_STEP = 1.0 / 240.0;
+
+// 回放相机路径时每帧前进的模拟时间（秒），与实际帧时间无关
+constexpr double REPLAY_STEP = 1.0 / 60.0;
+// 回放开始计时之前在路径起点渲染的最少帧数，同时等所有着色器编译完成
+constexpr int REPLAY_WARMUP_FRAMES = 60;
+
+// 命令行参数：--headless [--frames N] [--size WxH] [--out frame.ppm] [--record path.txt]
+//            [--replay path.txt [--report benchmark.json]]
+struct command_line {
+    // 不创建窗口，渲染到EGL pbuffer（需要用CG_HEADLESS编译）
+    bool headless = false;
+    // 渲染这么多帧后退出，0表示直到关闭窗口；无窗口模式默认300帧
+    int frames = 0;
+    int width = SCR_WIDTH;
+    int height = SCR_HEIGHT;
+    // 退出前把最后一帧保存为PPM
+    std::string out;
+    // 把这次运行中相机的输入录制到文件
+    std::string record;
+    // 按固定步长回放录制的相机路径，结束后把每帧的CPU/GPU时间统计写入report
+    std::string replay;
+    std::string report = "benchmark.json";
+};
+command_line options;
+
+// 录制或回放的相机路径：录制在主线程，回放只在渲染线程
+camera_path cameraPath;
+
+#ifdef CG_HEADLESS
+// 无窗口模式下代替GLFW窗口的上下文
+std::unique_ptr<headless_context> headless;
+#endif
+// 渲染线程结束时设置，两个线程都以此退出；无窗口模式下代替glfwWindowShouldClose
+std::atomic<bool> renderDone{false};
+const auto startTime = std::chrono::steady_clock::now();
+
 // 照相机实例化
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// 计时
+// 摄像机灯光（聚光灯）开关
+bool spotLightOn = true;
+bool spotLightKeyDown = false;
+
+// 分簇光照开关：关闭时只计算Lights块中的四个点光源
+bool clusteredLightsOn = true;
+bool clusteredKeyDown = false;
+
+// 延迟着色开关，用来和前向着色比较帧时间
+bool deferredOn = false;
+bool deferredKeyDown = false;
+
+// GPU驱动的剔除和间接绘制开关（需要OpenGL 4.3）
+bool gpuDrivenOn = false;
+bool gpuDrivenKeyDown = false;
+
+// 动态分辨率开关，关闭时按最大比例渲染
+bool dynamicResolutionOn = true;
+bool dynamicResolutionKeyDown = false;
+
+// 模拟线程的计时
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+// 当前模拟步的时间（秒），录制的键盘输入用它作时间
+double simulationTime = 0.0;
+
+// 以下几个函数对窗口和无窗口模式都适用，无窗口模式下window为nullptr，GLFW没有初始化
+double now_seconds() {
+    if (!options.headless)
+        return glfwGetTime();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool should_close(GLFWwindow *window) {
+    return renderDone || (window && glfwWindowShouldClose(window));
+}
+
+void framebuffer_size(GLFWwindow *window, int *width, int *height) {
+    if (!window) {
+        *width = options.width;
+        *height = options.height;
+        return;
+    }
+    glfwGetFramebufferSize(window, width, height);
+}
+
+void make_context_current(GLFWwindow *window, bool current) {
+#ifdef CG_HEADLESS
+    if (!window) {
+        if (current)
+            headless->make_current();
+        else
+            headless->release_current();
+        return;
+    }
+#endif
+    glfwMakeContextCurrent(current ? window : nullptr);
+}
+
+void swap_buffers(GLFWwindow *window) {
+#ifdef CG_HEADLESS
+    if (!window) {
+        headless->swap_buffers();
+        return;
+    }
+#endif
+    glfwSwapBuffers(window);
+}
+
+// 移动相机，录制时同时记下这次输入
+void moveCamera(Camera_Movement direction) {
+    if (!options.record.empty())
+        cameraPath.record_keyboard(simulationTime, direction, deltaTime);
+    camera.ProcessKeyboard(direction, deltaTime);
+}
 
 // 检测W，S，A，D，Esc键的按下与释放，并做出相应
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+    // 回放时相机只由路径驱动，其余按键照常
+    if (options.replay.empty()) {
+        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+            moveCamera(FORWARD);
+        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+            moveCamera(BACKWARD);
+        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+            moveCamera(LEFT);
+        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+            moveCamera(RIGHT);
+    }
     // 按E键关闭与开启摄像机灯光
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-        //TODO:关闭与开启灯光
+    const bool spotLightKey = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+    if (spotLightKey && !spotLightKeyDown) {
+        spotLightOn = !spotLightOn;
     }
+    spotLightKeyDown = spotLightKey;
+    // 按C键切换分簇光照
+    const bool clusteredKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (clusteredKey && !clusteredKeyDown) {
+        clusteredLightsOn = !clusteredLightsOn;
+    }
+    clusteredKeyDown = clusteredKey;
+    // 按G键切换延迟着色与前向着色
+    const bool deferredKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (deferredKey && !deferredKeyDown) {
+        deferredOn = !deferredOn;
+    }
+    deferredKeyDown = deferredKey;
+    // 按V键切换GPU驱动的剔除
+    const bool gpuDrivenKey = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+    if (gpuDrivenKey && !gpuDrivenKeyDown) {
+        gpuDrivenOn = !gpuDrivenOn;
+    }
+    gpuDrivenKeyDown = gpuDrivenKey;
+    // 按R键切换动态分辨率
+    const bool dynamicResolutionKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (dynamicResolutionKey && !dynamicResolutionKeyDown) {
+        dynamicResolutionOn = !dynamicResolutionOn;
+    }
+    dynamicResolutionKeyDown = dynamicResolutionKey;
+}
+
+// 一段时间内的平均帧时间
+struct frame_timer {
+    double seconds = 0.0;
+    int frames = 0;
+
+    void add(double frameSeconds) {
+        seconds += frameSeconds;
+        frames++;
+    }
+    double average_ms() const { return frames > 0 ? seconds / frames * 1000.0 : 0.0; }
+};
+
+// 绕随机圆周运动的点光源
+struct orbiting_light {
+    glm::vec3 center;
+    float radius;
+    float speed;
+    float phase;
+    glm::vec3 color;
+};
+
+// 在箱子所在的区域中随机生成演示光源
+std::vector<orbiting_light> make_demo_lights(int count) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> x(-5.0f, 4.0f), y(-4.0f, 4.0f), z(-13.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<orbiting_light> lights(count);
+    for (auto &light: lights) {
+        light.center = glm::vec3(x(random), y(random), z(random));
+        light.radius = 0.3f + unit(random);
+        light.speed = 0.5f + unit(random);
+        light.phase = unit(random) * 6.2831853f;
+        light.color = glm::vec3(0.2f) + 0.8f * glm::vec3(unit(random), unit(random), unit(random));
+    }
+    return lights;
+}
+
+// 模拟线程交给渲染线程的一帧状态，发布之后渲染线程只读
+struct frame_snapshot {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+    float zoom = 45.0f;
+    // 帧缓冲尺寸只能在主线程查询
+    int framebufferWidth = SCR_WIDTH;
+    int framebufferHeight = SCR_HEIGHT;
+    bool spotLight = true;
+    bool clustered = true;
+    bool deferred = false;
+    bool gpuDriven = false;
+    bool dynamicResolution = true;
+    // 演示光源这一时刻的位置
+    std::vector<glm::vec3> demoLightPositions;
+};
+
+// 模拟线程发布快照，渲染线程总是取最新的一份，双方都不等待对方
+triple_buffer<frame_snapshot> snapshots;
+// 反方向：渲染线程统计的标题文字，由主线程设置（GLFW只允许在主线程设置标题）
+triple_buffer<std::string> windowTitles;
+
+// 快照中的相机部分
+void snapshot_camera(Camera &source, frame_snapshot &snapshot) {
+    snapshot.view = source.GetViewMatrix();
+    snapshot.position = source.Position;
+    snapshot.front = source.Front;
+    snapshot.zoom = source.Zoom;
 }
 
-// 检测窗口尺寸是否发生变化
-void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    // 确保视口与新窗口尺寸匹配；宽度和高度将明显大于显示器上的指定值。
-    glViewport(0, 0, width, height);
+// 演示光源在time时刻的位置
+void orbit_demo_lights(const std::vector<orbiting_light> &demoLights, float time, std::vector<glm::vec3> &positions) {
+    positions.resize(demoLights.size());
+    for (std::size_t i = 0; i < demoLights.size(); i++) {
+        const orbiting_light &orbit = demoLights[i];
+        const float angle = orbit.phase + orbit.speed * time;
+        positions[i] = orbit.center + orbit.radius * glm::vec3(std::cos(angle), std::sin(angle * 0.7f), std::sin(angle));
+    }
+}
+
+// 模拟一步：处理输入，移动相机和光源，然后发布快照。只在主线程调用（GLFW的输入和帧缓冲尺寸只能在主线程查询）
+void simulate(GLFWwindow *window, const std::vector<orbiting_light> &demoLights, double time) {
+    cpu_scope scope("simulate");
+    simulationTime = time;
+    auto currentFrame = static_cast<float>(time);
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+    if (window)
+        processInput(window);
+
+    // 快照的每个字段都重新写入，槽位里的旧数据不会留下来
+    frame_snapshot &snapshot = snapshots.back();
+    snapshot_camera(camera, snapshot);
+    framebuffer_size(window, &snapshot.framebufferWidth, &snapshot.framebufferHeight);
+    snapshot.spotLight = spotLightOn;
+    snapshot.clustered = clusteredLightsOn;
+    snapshot.deferred = deferredOn;
+    snapshot.gpuDriven = gpuDrivenOn;
+    snapshot.dynamicResolution = dynamicResolutionOn;
+    orbit_demo_lights(demoLights, currentFrame, snapshot.demoLightPositions);
+    snapshots.publish();
 }
 
 // 当鼠标移动时回调
 void mouse_callback(GLFWwindow *window, double xposIn, double yposIn) {
+    // 回放时相机只由路径驱动
+    if (!options.replay.empty())
+        return;
     auto xpos = static_cast<float>(xposIn);
     auto ypos = static_cast<float>(yposIn);
 
@@ -66,62 +354,95 @@ void mouse_callback(GLFWwindow *window, double xposIn, double yposIn) {
     lastX = xpos;
     lastY = ypos;
 
+    if (!options.record.empty())
+        cameraPath.record_mouse(now_seconds(), xoffset, yoffset);
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
 // 当鼠标滚轮操作时回调
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+    if (!options.replay.empty())
+        return;
+    if (!options.record.empty())
+        cameraPath.record_scroll(now_seconds(), static_cast<float>(yoffset));
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
 
-// 用于从文件加载2D纹理的函数
-unsigned int loadTexture(char const *path) {
+// 用于从文件加载2D纹理的函数：等待工作线程生成的mipmap链，然后上传
+unsigned int loadTexture(std::future<mip_chain> chain) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+    try {
+        const mip_chain loaded = chain.get();
+        upload_mip_chain(textureID, loaded);
+        texture_residency::instance().track(textureID, loaded);
+    } catch (const std::string &e) {
+        std::cout << e << std::endl;
     }
     return textureID;
 }
 
-int main() {
-    // glfw的初始化和配置
-    utility::init();
-
-    // glfw窗口创建
-    const auto window = utility::creat_window(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", true, mouse_callback, scroll_callback);
+// 在渲染线程上创建资源并运行渲染循环。返回时所有持有OpenGL对象的变量都已析构，之后才能销毁上下文
+void run(GLFWwindow *window, const std::vector<orbiting_light> &demoLights) {
+    // 尽早开始在工作线程上解码纹理并生成mipmap，与着色器编译和模型加载并行
+    mip_source diffuseSource, specularSource;
+    diffuseSource.filename = "../resources/textures/container2.png";
+    specularSource.filename = "../resources/textures/container2_specular.png";
+    specularSource.channels = 1;
+    if (PACK_MATERIAL_MAPS) {
+        diffuseSource.alpha_filename = specularSource.filename;
+        diffuseSource.channels = 4;
+    }
+    auto diffuseChain = load_mip_chain_async(diffuseSource);
+    std::future<mip_chain> specularChain;
+    if (!PACK_MATERIAL_MAPS)
+        specularChain = load_mip_chain_async(specularSource);
 
     // 配置全局的OpenGL状态
     glEnable(GL_DEPTH_TEST);
 
     // 创建和编译着色器zprogram
-    Shader lightingShader("../6.multiple_lights.vs", "../6.multiple_lights.fs");
+    // 光源着色器最简单，同步编译；其他程序还没编译好时用它代替
     Shader lightCubeShader("../6.light_cube.vs", "../6.light_cube.fs");
-    Shader modelShader{"../1.model_loading.vs", "../1.model_loading.fs"};
+    // 其余程序一次性提交给编译队列，驱动可以并行编译，每帧检查是否完成
+    shader_compile_queue shaderQueue;
+    const auto modelShaderHandle = shaderQueue.submit("../1.model_loading.vs", "../1.model_loading.fs", {},
+                                                      [](const Shader &shader) {
+        bindFrameBlocks(shader);
+        shader.use();
+        material::bind_samplers(shader);
+    });
+    // 光照着色器按材质和场景中的光源生成变体
+    shader_library lightingShaders{shaderQueue, "../6.multiple_lights.vs", "../6.multiple_lights.fs",
+                                   [](const Shader &shader) {
+        bindFrameBlocks(shader);
+        shader.use();
+        light_clusters::bind_samplers(shader);
+        material::bind_samplers(shader);
+    }};
+    // 延迟着色：几何阶段只采样材质写入G缓冲，光照阶段对每个像素计算一次光照
+    shader_library geometryShaders{shaderQueue, "../6.multiple_lights.vs", "../deferred_geometry.fs",
+                                   [](const Shader &shader) {
+        bindFrameBlocks(shader);
+        shader.use();
+        material::bind_samplers(shader);
+    }};
+    shader_library deferredLightingShaders{shaderQueue, "../deferred_lighting.vs", "../deferred_lighting.fs",
+                                           [](const Shader &shader) {
+        bindFrameBlocks(shader);
+        shader.use();
+        light_clusters::bind_samplers(shader);
+        shader.setInt("gAlbedoSpec"_u, static_cast<int>(GBUFFER_ALBEDO_SPEC_UNIT));
+        shader.setInt("gNormal"_u, static_cast<int>(GBUFFER_NORMAL_UNIT));
+        shader.setInt("gDepth"_u, static_cast<int>(GBUFFER_DEPTH_UNIT));
+    }};
+
+    // 光源立方体的实例化变体，编译完成之前逐个绘制
+    const auto lightCubeInstancedHandle = shaderQueue.submit("../6.light_cube.vs", "../6.light_cube.fs",
+                                                             {"INSTANCING"}, [](const Shader &shader) {
+        bindFrameBlocks(shader);
+    });
 
     model trunk{"../resources/models/trunk.obj"};
 
@@ -133,7 +454,8 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindVertexArray(cubeVAO);
+    auto &glState = gl_state::instance();
+    glState.bind_vertex_array(cubeVAO);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) nullptr);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
@@ -144,7 +466,7 @@ int main() {
     // 其次,配置光源的VAO， VBO保持不变; 光源也是顶点组成的立方体。
     unsigned int lightCubeVAO;
     glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
+    glState.bind_vertex_array(lightCubeVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     // 更新了灯的位置属性的步长，以反映更新的缓冲区数据
@@ -152,166 +474,628 @@ int main() {
     glEnableVertexAttribArray(0);
 
     // 加载纹理
-    unsigned int diffuseMap = loadTexture("../resources/textures/container2.png");
-    unsigned int specularMap = loadTexture("../resources/textures/container2_specular.png");
+    unsigned int diffuseMap = loadTexture(std::move(diffuseChain));
+    unsigned int specularMap = PACK_MATERIAL_MAPS ? 0 : loadTexture(std::move(specularChain));
 
-    // 着色器配置
-    lightingShader.use();
-    lightingShader.setInt("material.diffuse", 0);
-    lightingShader.setInt("material.specular", 1);
+    // 相机和光源数据放在一个缓冲区的两个uniform块中，所有程序共享
+    bindFrameBlocks(lightCubeShader);
+    uniform_buffer frameUniforms{{CAMERA_BLOCK_BINDING, sizeof(camera_block)},
+                                 {LIGHTS_BLOCK_BINDING, sizeof(lights_block)}};
 
+    // 平行光
+    auto &lights = frameUniforms.block<lights_block>(1);
+    lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lights.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.1f);
+    lights.dirLight.diffuse = glm::vec3(0.2f, 0.2f, 0.7f);
+    lights.dirLight.specular = glm::vec3(0.7f, 0.7f, 0.7f);
+    // 点光源
+    for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+        lights.pointLights[i].position = pointLightPositions[i];
+        lights.pointLights[i].ambient = pointLightColors[i] * 0.1f;
+        lights.pointLights[i].diffuse = pointLightColors[i];
+        lights.pointLights[i].specular = pointLightColors[i];
+        lights.pointLights[i].constant = 1.0f;
+        lights.pointLights[i].linear = 0.09f;
+        lights.pointLights[i].quadratic = 0.032f;
+    }
+    // 聚光灯，位置和方向每帧跟随相机
+    lights.spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+    lights.spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+    lights.spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    lights.spotLight.constant = 1.0f;
+    lights.spotLight.linear = 0.009f;
+    lights.spotLight.quadratic = 0.0032f;
+    lights.spotLight.cutOff = glm::cos(glm::radians(10.0f));
+    lights.spotLight.outerCutOff = glm::cos(glm::radians(12.5f));
+
+    // 箱子材质有（可能打包的）镜面反射贴图，没有法线贴图
+    const material boxMaterial{{diffuseMap, specularMap, 0, 0, 0}, PACK_MATERIAL_MAPS, 32.0f};
+    shader_features boxFeatures = boxMaterial.features();
+    // 聚光灯开关两种变体都提前提交，切换时不用等待编译
+    boxFeatures.point_lights = MAX_POINT_LIGHTS;
+    boxFeatures.dir_light = true;
+    for (bool clustered: {true, false}) {
+        for (bool spot: {true, false}) {
+            shader_features features = boxFeatures;
+            features.spot_light = spot;
+            features.clustered = clustered;
+            features.point_lights = clustered ? 0 : MAX_POINT_LIGHTS;
+            // 不分簇时每个箱子只计算照到它的光源
+            features.object_lights = !clustered;
+            lightingShaders.prewarm(features);
+            // 渲染队列把连续相同的绘制合并成实例化绘制
+            features.instancing = true;
+            lightingShaders.prewarm(features);
+            features.instancing = false;
+            features.object_lights = false;
+            // 光照阶段只需要光源相关的宏
+            features.specular_map = false;
+            features.packed_specular = false;
+            features.normal_map = false;
+            deferredLightingShaders.prewarm(features);
+        }
+    }
+    // 几何阶段只需要材质相关的宏
+    const shader_features geometryFeatures = boxMaterial.features();
+    geometryShaders.prewarm(geometryFeatures);
+    shader_features geometryInstancedFeatures = geometryFeatures;
+    geometryInstancedFeatures.instancing = true;
+    geometryShaders.prewarm(geometryInstancedFeatures);
+
+    // 箱子是静态的，模型矩阵和世界空间包围盒只计算一次
+    const aabb cubeBounds{glm::vec3(-0.5f), glm::vec3(0.5f)};
+    glm::mat4 boxModels[10];
+    aabb boxWorldBounds[10];
+    for (unsigned int i = 0; i < 10; i++) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, cubePositions[i]);
+        float angle = 20.0f * i;
+        boxModels[i] = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+        boxWorldBounds[i] = cubeBounds.transformed(boxModels[i]);
+    }
+
+    // GPU驱动的剔除：十个箱子加上周围的随机箱子放进共享缓冲区，由计算着色器剔除后一次间接绘制
+    std::unique_ptr<gpu_scene> gpuScene;
+    if (gpu_scene::supported()) {
+        gpuScene = std::make_unique<gpu_scene>();
+        std::vector<vertex> cubeVertices(36);
+        std::vector<std::uint32_t> cubeIndices(36);
+        for (std::uint32_t i = 0; i < 36; i++) {
+            cubeVertices[i].position = glm::vec3(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]);
+            cubeVertices[i].normal = glm::vec3(vertices[i * 8 + 3], vertices[i * 8 + 4], vertices[i * 8 + 5]);
+            cubeVertices[i].tex_coords = glm::vec2(vertices[i * 8 + 6], vertices[i * 8 + 7]);
+            cubeIndices[i] = i;
+        }
+        const std::uint32_t cube = gpuScene->add_geometry(cubeVertices, cubeIndices);
+        for (const auto &boxModel: boxModels)
+            gpuScene->add_object(cube, boxModel);
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> x(-40.0f, 40.0f), y(-20.0f, 20.0f), z(-80.0f, -16.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        for (int i = 0; i < GPU_DEMO_BOXES; i++) {
+            const glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x(random), y(random), z(random)));
+            gpuScene->add_object(cube, glm::rotate(model, angle(random), glm::vec3(1.0f, 0.3f, 0.5f)));
+        }
+        gpuScene->upload();
+    }
+
+    g_buffer gBuffer;
+    // 场景按GPU时间缩放分辨率渲染，再放大到窗口
+    dynamic_resolution dynamicResolution;
+    dynamicResolution.set_target(DYNAMIC_RESOLUTION_TARGET_MS);
+    dynamicResolution.set_scale_range(DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+    // 延迟着色的全屏三角形不需要顶点数据，但核心模式必须绑定一个VAO
+    unsigned int emptyVAO;
+    glGenVertexArrays(1, &emptyVAO);
+
+    // 两种路径各自的平均帧时间；标题栏显示最近一秒的平均值
+    frame_timer pathTimes[2];
+    frame_timer titleTimer;
+    bool lastFrameDeferred = false;
+    bool lastFrameGpuDriven = false;
+
+    // 每帧的动态数据（uniform块和实例矩阵）写入持久映射的环形缓冲区，三帧轮换
+    ring_buffer frameRing(1 << 20);
+    render_queue renderQueue;
+    renderQueue.set_ring(&frameRing);
+    // 视锥体剔除：每帧把包围体放进SoA数组，只提交可见的对象
+    aabb_list boxBounds;
+    sphere_list lightCubeBounds;
+    std::vector<std::uint32_t> visible;
+    // 遮挡剔除：可见的箱子作为遮挡物画进CPU深度缓冲，再用它测试所有对象
+    occlusion_buffer occlusion;
+    std::size_t visibleObjects = 0, totalObjects = 0;
+
+    // 分簇光照：Lights块中的四个点光源加上演示光源，每帧重新分配到簇中
+    light_clusters clusters;
+    // 不分簇时的逐对象光源列表
+    light_assignment lightAssignment;
+    std::vector<point_light_std140> clusteredLights(MAX_POINT_LIGHTS + demoLights.size());
+    for (int i = 0; i < MAX_POINT_LIGHTS; i++)
+        clusteredLights[i] = lights.pointLights[i];
+    for (std::size_t i = 0; i < demoLights.size(); i++) {
+        point_light_std140 &light = clusteredLights[MAX_POINT_LIGHTS + i];
+        light.ambient = glm::vec3(0.0f);
+        light.diffuse = demoLights[i].color * 0.5f;
+        light.specular = demoLights[i].color * 0.5f;
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.quadratic = 1.8f;
+    }
+
+    // 每帧的CPU和GPU计时区间，退出时输出统计并写入Chrome trace
+    auto &profile = profiler::instance();
 
     // 渲染
-    while (!glfwWindowShouldClose(window)) {
+    double lastRenderTime = now_seconds();
+    int renderedFrames = 0;
+    // 回放：预热的帧数，以及开始计时后的帧号（预热时为-1）
+    int warmupFrames = 0;
+    int replayFrame = -1;
+    bool replayEnded = false;
+    // 回放的相机属于渲染线程，主线程的相机不参与
+    Camera replayCamera;
+    frame_snapshot replaySnapshot;
+    if (!options.replay.empty()) {
+        cameraPath.rewind(replayCamera);
+        // 统计覆盖整段路径的每一帧
+        profile.set_window(static_cast<std::size_t>(cameraPath.duration() / REPLAY_STEP) + 2);
+    }
+    while (!should_close(window)) {
+        profile.begin_frame();
+        profile.begin_cpu("frame");
+        profile.begin_gpu("frame");
         // 每帧时间逻辑
-        auto currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        const double renderTime = now_seconds();
+        const double frameTime = renderTime - lastRenderTime;
+        lastRenderTime = renderTime;
+        pathTimes[lastFrameDeferred].add(frameTime);
+        titleTimer.add(frameTime);
+        if (titleTimer.seconds >= 1.0) {
+            // 读回GPU剔除的计数会等待GPU，只在更新标题时读一次
+            std::size_t shownVisible = visibleObjects, shownTotal = totalObjects;
+            if (lastFrameGpuDriven) {
+                shownVisible += gpuScene->visible_count();
+                shownTotal += gpuScene->object_count();
+            }
+            std::string &title = windowTitles.back();
+            title = std::string("LearnOpenGL - ") + (lastFrameDeferred ? "deferred " : "forward ") +
+                    std::to_string(titleTimer.average_ms()) + " ms, " +
+                    std::to_string(renderQueue.stats().draws) + " draws (" +
+                    std::to_string(renderQueue.stats().instanced_draws) + " instanced), " +
+                    std::to_string(renderQueue.stats().state_changes()) + " state changes, " +
+                    std::to_string(shownVisible) + "/" + std::to_string(shownTotal) + " visible, " +
+                    std::to_string(static_cast<int>(dynamicResolution.scale() * 100.0f + 0.5f)) + "% scale (GPU " +
+                    std::to_string(dynamicResolution.gpu_milliseconds()) + " ms)";
+            windowTitles.publish();
+            titleTimer = frame_timer{};
+        }
 
-        // 输入
-        processInput(window);
+        // 取模拟线程最新发布的快照；没有新快照时沿用上一份
+        snapshots.acquire();
+        const frame_snapshot *current = &snapshots.front();
+        if (!options.replay.empty()) {
+            // 回放时渲染线程按帧号推进路径，相机和光源只取决于帧号；开关和帧缓冲尺寸仍取自快照
+            if (replayFrame < 0 && ++warmupFrames >= REPLAY_WARMUP_FRAMES && shaderQueue.pending() == 0) {
+                // 预热结束，从这一帧开始统计
+                replayFrame = 0;
+                profile.clear_stats();
+            }
+            const double time = replayFrame < 0 ? 0.0 : replayFrame * REPLAY_STEP;
+            cameraPath.replay_until(replayCamera, time);
+            replaySnapshot = *current;
+            snapshot_camera(replayCamera, replaySnapshot);
+            orbit_demo_lights(demoLights, static_cast<float>(time), replaySnapshot.demoLightPositions);
+            current = &replaySnapshot;
+            if (replayFrame >= 0) {
+                // 路径上最后一个输入之后的第一帧是最后一帧
+                replayEnded = time >= cameraPath.duration();
+                replayFrame++;
+            }
+        }
+        const frame_snapshot &frame = *current;
 
-        // 渲染
+        // 渲染：场景画进动态分辨率的离屏目标，下面的尺寸都是缩放后的
+        dynamicResolution.set_enabled(frame.dynamicResolution);
+        dynamicResolution.begin_frame(frame.framebufferWidth, frame.framebufferHeight);
+        const int renderWidth = dynamicResolution.width();
+        const int renderHeight = dynamicResolution.height();
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // 设置uniforms/drawing对象之前，激活着色器
+        // 视图和投影 变换，宽高比取自帧缓冲，--size和改变窗口大小都不会拉伸；最小化时高度为0，沿用默认比例
+        const float aspect = frame.framebufferHeight > 0
+                             ? static_cast<float>(frame.framebufferWidth) / static_cast<float>(frame.framebufferHeight)
+                             : static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT);
+        glm::mat4 projection = glm::perspective(glm::radians(frame.zoom), aspect, Z_NEAR, Z_FAR);
+        glm::mat4 view = frame.view;
+
+        // 相机和聚光灯每帧变化，所有uniform块一次写入
+        auto &cameraData = frameUniforms.block<camera_block>(0);
+        cameraData.projection = projection;
+        cameraData.view = view;
+        cameraData.viewPos = frame.position;
+        auto &lights = frameUniforms.block<lights_block>(1);
+        lights.spotLight.position = frame.position;
+        lights.spotLight.direction = frame.front;
+        frameRing.begin_frame();
+        frameUniforms.upload(frameRing);
+
+        // 完成已经编译好的程序；未完成的用光源着色器代替
+        shaderQueue.poll();
+        const Shader *modelProgram = shaderQueue.get(modelShaderHandle);
+        const Shader &modelShader = modelProgram ? *modelProgram : lightCubeShader;
+
+        // 选择与材质和当前光源匹配的最便宜的变体
+        shader_features features = boxFeatures;
+        features.spot_light = frame.spotLight;
+        features.clustered = frame.clustered;
+        features.point_lights = frame.clustered ? 0 : MAX_POINT_LIGHTS;
+        features.object_lights = !frame.clustered;
+        if (frame.clustered) {
+            cpu_scope scope("light clusters");
+            // 演示光源移到快照中的位置，重新分簇
+            for (std::size_t i = 0; i < frame.demoLightPositions.size(); i++)
+                clusteredLights[MAX_POINT_LIGHTS + i].position = frame.demoLightPositions[i];
+            clusters.update(clusteredLights, view, projection, Z_NEAR, Z_FAR, renderWidth, renderHeight);
+        }
+        // 延迟着色的两个程序都编译好之前先用前向着色
+        const Shader *geometryProgram = geometryShaders.get(geometryFeatures);
+        shader_features lightFeatures = features;
+        lightFeatures.specular_map = false;
+        lightFeatures.packed_specular = false;
+        lightFeatures.normal_map = false;
+        lightFeatures.object_lights = false;
+        const Shader *deferredProgram = deferredLightingShaders.get(lightFeatures);
+        const bool deferred = frame.deferred && geometryProgram && deferredProgram;
+        lastFrameDeferred = deferred;
+        // 前向着色不分簇时，CPU按衰减半径给每个箱子挑选光源
+        const bool objectLights = features.object_lights && !deferred;
+        if (objectLights)
+            lightAssignment.set_lights(lights, MAX_POINT_LIGHTS, frame.spotLight);
+
+        const Shader *lightingProgram = deferred ? geometryProgram : lightingShaders.get(features);
+        const Shader &lightingShader = lightingProgram ? *lightingProgram : lightCubeShader;
+        shader_features instancedFeatures = features;
+        instancedFeatures.instancing = true;
+        const Shader *instancedProgram = !lightingProgram ? nullptr
+                                         : deferred ? geometryShaders.get(geometryInstancedFeatures)
+                                                    : lightingShaders.get(instancedFeatures);
+        // GPU驱动的路径用实例化变体绘制，变体编译好之前用CPU提交
+        const bool gpuDriven = frame.gpuDriven && gpuScene && instancedProgram;
+        lastFrameGpuDriven = gpuDriven;
+        if (deferred) {
+            gBuffer.resize(dynamicResolution.target_width(), dynamicResolution.target_height());
+            gBuffer.bind_for_geometry(renderWidth, renderHeight);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        // 每个程序每帧一次的uniform先设置好，绘制由渲染队列按排序键完成
         lightingShader.use();
-        lightingShader.setVec3("viewPos", camera.Position);
-        lightingShader.setFloat("material.shininess", 32.0f);
-
-        modelShader.use();
-
-        // 平行光
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.1f);
-        lightingShader.setVec3("dirLight.diffuse", 0.2f, 0.2f, 0.7);
-        lightingShader.setVec3("dirLight.specular", 0.7f, 0.7f, 0.7f);
-        // 点光源1
-        lightingShader.setVec3("pointLights[0].position", pointLightPositions[0].x, pointLightPositions[0].y,
-                               pointLightPositions[0].z);
-        lightingShader.setVec3("pointLights[0].ambient", pointLightColors[0].x * 0.1, pointLightColors[0].y * 0.1,
-                               pointLightColors[0].z * 0.1);
-        lightingShader.setVec3("pointLights[0].diffuse", pointLightColors[0].x, pointLightColors[0].y,
-                               pointLightColors[0].z);
-        lightingShader.setVec3("pointLights[0].specular", pointLightColors[0].x, pointLightColors[0].y,
-                               pointLightColors[0].z);
-        lightingShader.setFloat("pointLights[0].constant", 1.0f);
-        lightingShader.setFloat("pointLights[0].linear", 0.09f);
-        lightingShader.setFloat("pointLights[0].quadratic", 0.032f);
-        // 点光源2
-        lightingShader.setVec3("pointLights[1].position", pointLightPositions[1].x, pointLightPositions[1].y,
-                               pointLightPositions[1].z);
-        lightingShader.setVec3("pointLights[1].ambient", pointLightColors[1].x * 0.1, pointLightColors[1].y * 0.1,
-                               pointLightColors[1].z * 0.1);
-        lightingShader.setVec3("pointLights[1].diffuse", pointLightColors[1].x, pointLightColors[1].y,
-                               pointLightColors[1].z);
-        lightingShader.setVec3("pointLights[1].specular", pointLightColors[1].x, pointLightColors[1].y,
-                               pointLightColors[1].z);
-        lightingShader.setFloat("pointLights[1].constant", 1.0f);
-        lightingShader.setFloat("pointLights[1].linear", 0.09f);
-        lightingShader.setFloat("pointLights[1].quadratic", 0.032f);
-        // 点光源3
-        lightingShader.setVec3("pointLights[2].position", pointLightPositions[2].x, pointLightPositions[2].y,
-                               pointLightPositions[2].z);
-        lightingShader.setVec3("pointLights[2].ambient", pointLightColors[2].x * 0.1, pointLightColors[2].y * 0.1,
-                               pointLightColors[2].z * 0.1);
-        lightingShader.setVec3("pointLights[2].diffuse", pointLightColors[2].x, pointLightColors[2].y,
-                               pointLightColors[2].z);
-        lightingShader.setVec3("pointLights[2].specular", pointLightColors[2].x, pointLightColors[2].y,
-                               pointLightColors[2].z);
-        lightingShader.setFloat("pointLights[2].constant", 1.0f);
-        lightingShader.setFloat("pointLights[2].linear", 0.09f);
-        lightingShader.setFloat("pointLights[2].quadratic", 0.032f);
-        // 点光源4
-        lightingShader.setVec3("pointLights[3].position", pointLightPositions[3].x, pointLightPositions[3].y,
-                               pointLightPositions[3].z);
-        lightingShader.setVec3("pointLights[3].ambient", pointLightColors[3].x * 0.1, pointLightColors[3].y * 0.1,
-                               pointLightColors[3].z * 0.1);
-        lightingShader.setVec3("pointLights[3].diffuse", pointLightColors[3].x, pointLightColors[3].y,
-                               pointLightColors[3].z);
-        lightingShader.setVec3("pointLights[3].specular", pointLightColors[3].x, pointLightColors[3].y,
-                               pointLightColors[3].z);
-        lightingShader.setFloat("pointLights[3].constant", 1.0f);
-        lightingShader.setFloat("pointLights[3].linear", 0.09f);
-        lightingShader.setFloat("pointLights[3].quadratic", 0.032f);
-        // 聚光灯
-        lightingShader.setVec3("spotLight.position", camera.Position.x, camera.Position.y, camera.Position.z);
-        lightingShader.setVec3("spotLight.direction", camera.Front.x, camera.Front.y, camera.Front.z);
-        lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("spotLight.constant", 1.0f);
-        lightingShader.setFloat("spotLight.linear", 0.009f);
-        lightingShader.setFloat("spotLight.quadratic", 0.0032f);
-        lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(10.0f)));
-        lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(12.5f)));
-
-        // 视图和投影 变换
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f,
-                                                100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
+        if (frame.clustered && !deferred)
+            clusters.bind(lightingShader);
+        if (instancedProgram) {
+            instancedProgram->use();
+            if (frame.clustered && !deferred)
+                clusters.bind(*instancedProgram);
+        }
+
+        renderQueue.begin_frame(view, Z_FAR);
+        const frustum viewFrustum = frustum::from_matrix(projection * view);
+        profile.begin_cpu("culling");
+        // 箱子
+        boxBounds.clear();
+        for (const auto &bounds: boxWorldBounds)
+            boxBounds.add(bounds);
+        visible.clear();
+        cull_aabbs(viewFrustum, boxBounds, visible);
+        occlusion.begin_frame(projection * view);
+        for (auto index: visible)
+            occlusion.add_triangles(vertices, 8, 36, boxModels[index]);
+        occlusion.rasterize();
+        occlusion.filter(boxBounds, visible);
+        visibleObjects = visible.size();
+        totalObjects = boxBounds.count;
+        if (gpuDriven) {
+            gpu_scope scope("gpu culling");
+            // 箱子全部由计算着色器剔除，CPU遮挡缓冲作为Hi-Z
+            gpuScene->cull(projection * view, &occlusion);
+            visible.clear();
+            visibleObjects = totalObjects = 0;
+        }
+        profile.end_cpu();
+        draw_command box;
+        box.shader = &lightingShader;
+        box.instanced = instancedProgram;
+        box.vao = cubeVAO;
+        box.count = 36;
+        box.mat = &boxMaterial;
+        for (auto index: visible) {
+            box.model = boxModels[index];
+            if (objectLights)
+                box.lights = lightAssignment.assign(boxWorldBounds[index]);
+            renderQueue.submit(render_pass::opaque, box);
+        }
+
+        // 模型没有光照，两种路径都在光照之后前向绘制
         glm::mat4 trunk_model = glm::mat4(1.0f);
         trunk_model = glm::translate(trunk_model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
         trunk_model = glm::scale(trunk_model, glm::vec3(1.0f, 1.0f, 1.0f));
-        modelShader.setMat4("model", trunk_model);
-        trunk.draw(modelShader);
-
-        // 全局变换
-        glm::mat4x4 model;
-        model = glm::mat4(1.0f);
-        lightingShader.setMat4("model", model);
-
-        // 绑定漫反射贴图
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
-
-        // 渲染对象
-        glBindVertexArray(cubeVAO);
-        for (unsigned int i = 0; i < 10; i++) {
-            // 计算每个对象的模型矩阵，并在绘制之前将其传递给着色器
+        visibleObjects += trunk.submit(renderQueue, render_pass::unlit, modelShader, trunk_model, viewFrustum, &occlusion);
+        totalObjects += trunk.mesh_count();
+
+        // 光源对象，包围球半径是缩放后立方体的半对角线
+        lightCubeBounds.clear();
+        for (auto &pointLightPosition: pointLightPositions)
+            lightCubeBounds.add(pointLightPosition, 0.2f * 0.8660254f);
+        visible.clear();
+        cull_spheres(viewFrustum, lightCubeBounds, visible);
+        visible.erase(std::remove_if(visible.begin(), visible.end(), [&](std::uint32_t index) {
+            const glm::vec3 extent(lightCubeBounds.radius[index]);
+            return !occlusion.visible(aabb{pointLightPositions[index] - extent, pointLightPositions[index] + extent});
+        }), visible.end());
+        visibleObjects += visible.size();
+        totalObjects += lightCubeBounds.count;
+        draw_command lightCube;
+        lightCube.shader = &lightCubeShader;
+        lightCube.instanced = shaderQueue.get(lightCubeInstancedHandle);
+        lightCube.vao = lightCubeVAO;
+        lightCube.count = 36;
+        for (auto index: visible) {
             glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            lightingShader.setMat4("model", model);
+            model = glm::translate(model, pointLightPositions[index]);
+            lightCube.model = glm::scale(model, glm::vec3(0.2f));
+            renderQueue.submit(render_pass::unlit, lightCube);
+        }
+        renderQueue.sort();
+
+        // 动态分辨率只计时GPU的绘制：上面的CPU工作期间GPU空闲，不能算进去
+        dynamicResolution.begin_timing();
+        {
+            gpu_scope scope("opaque pass");
+            renderQueue.execute(render_pass::opaque);
+            if (gpuDriven) {
+                instancedProgram->use();
+                boxMaterial.bind(*instancedProgram);
+                // 间接绘制的对象没有逐对象列表，计算所有光源
+                if (objectLights)
+                    lightAssignment.all().bind(*instancedProgram);
+                gpuScene->draw();
+            }
+        }
+        if (deferred) {
+            gpu_scope scope("deferred lighting");
+            // 光照阶段：全屏三角形读取G缓冲，同时写回深度
+            dynamicResolution.bind();
+            deferredProgram->use();
+            if (frame.clustered)
+                clusters.bind(*deferredProgram);
+            deferredProgram->setMat4("inverseViewProjection"_u, glm::inverse(projection * view));
+            deferredProgram->setFloat("shininess"_u, boxMaterial.shininess());
+            deferredProgram->setVec2("viewportSize"_u, static_cast<float>(renderWidth),
+                                     static_cast<float>(renderHeight));
+            gBuffer.bind_textures();
+            glDepthFunc(GL_ALWAYS);
+            glState.bind_vertex_array(emptyVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glDepthFunc(GL_LESS);
+        }
+        {
+            gpu_scope scope("unlit pass");
+            renderQueue.execute(render_pass::unlit);
+        }
+        {
+            // 放大到默认帧缓冲
+            gpu_scope scope("upscale");
+            dynamicResolution.end_frame();
+        }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        // 上传重新加载完成的纹理，超出显存预算时淘汰最久未使用的纹理
+        texture_residency::instance().update();
+
+        // 达到指定帧数时结束，交换之前默认帧缓冲里还是这一帧
+        if ((options.frames > 0 && ++renderedFrames >= options.frames) || replayEnded) {
+            if (!options.out.empty() && !utility::save_framebuffer(options.out, frame.framebufferWidth,
+                                                                   frame.framebufferHeight))
+                std::cout << "ERROR::FRAMEBUFFER:: can't write " << options.out << std::endl;
+            renderDone = true;
         }
 
-        // 绘制光源对象
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-
-        glBindVertexArray(lightCubeVAO);
-        for (auto &pointLightPosition: pointLightPositions) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPosition);
-            model = glm::scale(model, glm::vec3(0.2f));
-            lightCubeShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        // glfw: 交换缓冲区；输入事件由主线程处理
+        frameRing.end_frame();
+        {
+            cpu_scope scope("swap");
+            swap_buffers(window);
         }
+        profile.end_gpu();
+        profile.end_cpu();
+        profile.end_frame();
+    }
 
-        // glfw: 交换缓冲区和检测输入输出（按键/释放、鼠标移动等）
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    std::cout << "forward: " << pathTimes[0].average_ms() << " ms/frame over " << pathTimes[0].frames
+              << " frames, deferred: " << pathTimes[1].average_ms() << " ms/frame over " << pathTimes[1].frames
+              << " frames" << std::endl;
+    // 被跳过的状态调用所占比例
+    std::cout << "GL state calls: " << glState.issued() << " issued, " << glState.skipped() << " skipped"
+              << std::endl;
+    std::cout << "frame ring: " << (frameRing.persistent() ? "persistent" : "unsynchronised maps") << ", "
+              << frameRing.stalls() << " stalled frames" << std::endl;
+    // 最近240帧每个计时区间的最小/平均/p99时间
+    std::cout << profile.report();
+    if (profile.write_chrome_trace("profile.json"))
+        std::cout << "trace of the last frames written to profile.json" << std::endl;
+    if (!options.replay.empty()) {
+        // 同一条路径在不同版本之间比较时需要知道在什么上面跑的
+        const std::vector<std::pair<std::string, std::string>> info = {
+            {"path", options.replay},
+            {"frames", std::to_string(std::max(replayFrame, 0))},
+            {"step_ms", std::to_string(REPLAY_STEP * 1000.0)},
+            {"size", std::to_string(options.width) + "x" + std::to_string(options.height)},
+            {"renderer", reinterpret_cast<const char *>(glGetString(GL_RENDERER))},
+            {"version", reinterpret_cast<const char *>(glGetString(GL_VERSION))}
+        };
+        if (profile.write_stats_json(options.report, info))
+            std::cout << "replay of " << std::max(replayFrame, 0) << " frames written to " << options.report
+                      << std::endl;
+        else
+            std::cout << "ERROR::BENCHMARK:: can't write " << options.report << std::endl;
     }
+    profile.release_gpu();
 
     // 一旦资源超出其用途，则取消分配：
+    glState.forget_vertex_array(cubeVAO);
+    glState.forget_vertex_array(lightCubeVAO);
+    glState.forget_vertex_array(emptyVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteBuffers(1, &VBO);
+    texture_residency::instance().release(diffuseMap);
+    if (!PACK_MATERIAL_MAPS)
+        texture_residency::instance().release(specularMap);
+}
+
+// 解析命令行参数，有不认识或格式不对的参数时返回false
+bool parse_arguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (argument == "--headless") {
+            options.headless = true;
+        } else if (argument == "--frames" && hasValue) {
+            options.frames = std::max(0, std::atoi(argv[++i]));
+        } else if (argument == "--size" && hasValue) {
+            int width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cout << "ERROR::ARGUMENTS:: --size expects WIDTHxHEIGHT, got " << argv[i] << std::endl;
+                return false;
+            }
+            options.width = width;
+            options.height = height;
+        } else if (argument == "--out" && hasValue) {
+            options.out = argv[++i];
+        } else if (argument == "--record" && hasValue) {
+            options.record = argv[++i];
+        } else if (argument == "--replay" && hasValue) {
+            options.replay = argv[++i];
+        } else if (argument == "--report" && hasValue) {
+            options.report = argv[++i];
+        } else {
+            std::cout << "ERROR::ARGUMENTS:: unknown argument " << argument << std::endl;
+            std::cout << "usage: CG [--headless] [--frames N] [--size WIDTHxHEIGHT] [--out frame.ppm] "
+                         "[--record path.txt] [--replay path.txt [--report benchmark.json]]" << std::endl;
+            return false;
+        }
+    }
+    if (!options.record.empty() && !options.replay.empty()) {
+        std::cout << "ERROR::ARGUMENTS:: --record and --replay can't be used together" << std::endl;
+        return false;
+    }
+    // 回放在路径结束时退出
+    if (options.headless && options.frames == 0 && options.replay.empty())
+        options.frames = 300;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parse_arguments(argc, argv))
+        return 1;
+    if (!options.replay.empty()) {
+        try {
+            cameraPath.load(options.replay);
+        } catch (const std::string &e) {
+            std::cout << e << std::endl;
+            return 1;
+        }
+        // 动态分辨率会随帧时间改变画面和负载，回放固定用最大比例
+        dynamicResolutionOn = false;
+    } else if (!options.record.empty()) {
+        cameraPath.start(camera);
+    }
 
+    GLFWwindow *window = nullptr;
+    if (options.headless) {
+#ifdef CG_HEADLESS
+        // 无窗口：EGL pbuffer就是默认帧缓冲，同样先请求OpenGL 4.3，不支持时退回3.3
+        try {
+            headless = std::make_unique<headless_context>(options.width, options.height, 4, 3);
+        } catch (const char *) {
+            try {
+                headless = std::make_unique<headless_context>(options.width, options.height, 3, 3);
+            } catch (const char *e) {
+                std::cout << e << std::endl;
+                return 1;
+            }
+        }
+#else
+        std::cout << "ERROR::ARGUMENTS:: --headless needs a build configured with -DCG_HEADLESS=ON" << std::endl;
+        return 1;
+#endif
+    } else {
+        // glfw的初始化和配置：先请求OpenGL 4.3（GPU驱动的剔除），不支持时退回3.3
+        utility::init(4, 3);
+
+        // glfw窗口创建
+        try {
+            window = utility::creat_window(options.width, options.height, "LearnOpenGL", true, mouse_callback,
+                                           scroll_callback);
+        } catch (const char *) {
+            utility::init(3, 3);
+            window = utility::creat_window(options.width, options.height, "LearnOpenGL", true, mouse_callback,
+                                           scroll_callback);
+        }
+
+        // 视口由渲染线程按快照中的帧缓冲尺寸每帧设置，主线程上没有OpenGL上下文
+        glfwSetFramebufferSizeCallback(window, nullptr);
+    }
+
+    // 主线程是模拟线程：GLFW的事件和输入只能在主线程处理。先发布第一份快照，再把上下文交给渲染线程
+    const std::vector<orbiting_light> demoLights = make_demo_lights(DEMO_LIGHTS);
+    simulate(window, demoLights, now_seconds());
+    make_context_current(window, false);
+    std::thread renderThread([window, &demoLights] {
+        profiler::instance().name_thread("render");
+        make_context_current(window, true);
+        try {
+            run(window, demoLights);
+        } catch (const std::string &e) {
+            std::cout << e << std::endl;
+        }
+        renderDone = true;
+        make_context_current(window, false);
+    });
+
+    // 模拟循环不等待渲染：没有输入事件时最多等待一个模拟步长
+    profiler::instance().name_thread("simulation");
+    while (!should_close(window)) {
+        if (window)
+            glfwWaitEventsTimeout(SIMULATION_STEP);
+        else
+            std::this_thread::sleep_for(std::chrono::duration<double>(SIMULATION_STEP));
+        simulate(window, demoLights, now_seconds());
+        // 没有窗口时标题打印到标准输出
+        if (windowTitles.acquire()) {
+            if (window)
+                glfwSetWindowTitle(window, windowTitles.front().c_str());
+            else
+                std::cout << windowTitles.front() << std::endl;
+        }
+    }
+    renderThread.join();
+
+    if (!options.record.empty()) {
+        if (cameraPath.save(options.record))
+            std::cout << "camera path of " << cameraPath.size() << " inputs written to " << options.record << std::endl;
+        else
+            std::cout << "ERROR::CAMERA_PATH:: can't write " << options.record << std::endl;
+    }
+
+#ifdef CG_HEADLESS
+    headless.reset();
+#endif
     // 终止，清除所有先前分配的GLFW
-    glfwTerminate();
+    if (window)
+        glfwTerminate();
     return 0;
 }
-
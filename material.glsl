@@ -0,0 +1,46 @@
+// 材质和顶点着色器的输出，前向着色和G缓冲共用（6.multiple_lights.vs的输出）
+// 使用的变体宏: HAS_SPECULAR_MAP, PACKED_SPECULAR, HAS_NORMAL_MAP（见6.multiple_lights.fs）
+
+struct Material {
+    sampler2D diffuse;
+#if defined(HAS_SPECULAR_MAP) && !defined(PACKED_SPECULAR)
+    sampler2D specular;
+#endif
+#ifdef HAS_NORMAL_MAP
+    sampler2D normal;
+#endif
+    float specularStrength;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+#ifdef HAS_NORMAL_MAP
+in mat3 TBN;
+#endif
+
+uniform Material material;
+
+// 采样材质贴图得到片段的表面属性，每个片段只采样一次
+Surface SampleSurface()
+{
+    vec4 albedoSpec = texture(material.diffuse, TexCoords);
+    Surface surface;
+    surface.position = FragPos;
+    surface.albedo = albedoSpec.rgb;
+#if defined(PACKED_SPECULAR)
+    surface.specularMask = albedoSpec.a;
+#elif defined(HAS_SPECULAR_MAP)
+    surface.specularMask = texture(material.specular, TexCoords).r;
+#else
+    surface.specularMask = material.specularStrength;
+#endif
+#ifdef HAS_NORMAL_MAP
+    surface.normal = normalize(TBN * (texture(material.normal, TexCoords).rgb * 2.0 - 1.0));
+#else
+    surface.normal = normalize(Normal);
+#endif
+    surface.shininess = material.shininess;
+    return surface;
+}
@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+// 动态分辨率的放大：把离屏目标左下角按比例渲染的区域双线性拉伸到整个窗口
+// 顶点着色器是deferred_lighting.vs的全屏三角形
+
+uniform sampler2D scene;
+// 窗口的像素尺寸
+uniform vec2 screenSize;
+// 渲染区域占整个纹理的比例
+uniform vec2 uvScale;
+// 纹理坐标的上限，离区域边缘半个纹素，双线性过滤不会采到区域外的像素
+uniform vec2 uvMax;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / screenSize * uvScale;
+    FragColor = vec4(texture(scene, min(uv, uvMax)).rgb, 1.0);
+}